@@ -0,0 +1,361 @@
+#!/bin/sh
+#
+# Copyright (c) 2018 Martin Storsjo
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Measure the overhead of the toolchain wrappers, by running a large number
+# of trivial invocations through each of them, and through the wrapped
+# tool directly, for comparison.
+#
+# For each entry point, the p50 and p99 latency (in microseconds) is
+# reported. If strace and valgrind are available, the number of syscalls
+# and the number of bytes allocated (summed over all processes involved)
+# for one invocation are reported too.
+#
+# With --wine=<dir>, also run the same measurements on a toolchain built
+# for Windows, installed in <dir>, under Wine. The option can be given
+# multiple times, e.g. to compare toolchains built with and without a
+# change to the wrappers, measured one after another in the same run.
+#
+# With --windows-pch, also measure compiling a few of the test sources that
+# start by including windows.h, with and without LLVM_MINGW_WINDOWS_PCH set
+# (which requires having run build-windows-pch.sh first), and show whether
+# the precompiled header was used for each of them. With --modules, compare
+# compiling the same sources with and without -fmodules. With --stat-cache,
+# compare the number of syscalls for compiling test/hello-cpp.cpp with and
+# without the stat caches generated by build-stat-cache.sh. With
+# --driver-layout, compare a trivial compile with clang searching for its
+# config file and sysroot, against passing them explicitly, as the wrappers
+# do.
+#
+# With --thinlto-relink=<dir>, build the C sources in <dir> (e.g. the
+# individual sources of SQLite, as in its "tsrc" directory, with
+# THINLTO_CFLAGS set to any extra options needed) with -flto=thin, and
+# measure relinking after changing one of them (THINLTO_CHANGED, or the
+# first one), with and without LLVM_MINGW_THINLTO_CACHE.
+
+set -e
+
+unset WINE_PREFIX_DIRS
+unset WINDOWS_PCH
+unset MODULES
+unset STAT_CACHE
+unset DRIVER_LAYOUT
+unset THINLTO_RELINK
+ITERATIONS=1000
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+    --wine=*)
+        WINE_PREFIX_DIRS="$WINE_PREFIX_DIRS $(cd "${1#*=}" && pwd)"
+        ;;
+    --iterations=*)
+        ITERATIONS="${1#*=}"
+        ;;
+    --windows-pch)
+        WINDOWS_PCH=1
+        ;;
+    --modules)
+        MODULES=1
+        ;;
+    --stat-cache)
+        STAT_CACHE=1
+        ;;
+    --driver-layout)
+        DRIVER_LAYOUT=1
+        ;;
+    --thinlto-relink=*)
+        THINLTO_RELINK="${1#*=}"
+        ;;
+    *)
+        PREFIX="$1"
+        ;;
+    esac
+    shift
+done
+if [ -z "$PREFIX" ]; then
+    echo $0 [--iterations=N] [--wine=windows-toolchain] [--windows-pch] [--modules] [--stat-cache] [--driver-layout] [--thinlto-relink=srcdir] dest
+    exit 1
+fi
+PREFIX="$(cd "$PREFIX" && pwd)"
+if [ -n "$WINE_PREFIX_DIRS" ]; then
+    : ${WINE:=wine}
+fi
+
+: ${CC:=cc}
+: ${TARGET:=x86_64-w64-mingw32}
+: ${ARCH:=${TARGET%%-*}}
+case $ARCH in
+i686)    M=i386pe    ;;
+x86_64)  M=i386pep   ;;
+armv7)   M=thumb2pe  ;;
+aarch64) M=arm64pe   ;;
+arm64ec) M=arm64ecpe ;;
+esac
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cat<<EOF > $TMP/bench-exec.c
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static int cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3)
+        return 1;
+    int n = atoi(argv[1]);
+    double *times = malloc(n * sizeof(*times));
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    for (int i = 0; i < n; i++) {
+        struct timespec start, end;
+        pid_t pid;
+        int status;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (posix_spawnp(&pid, argv[2], &actions, NULL, &argv[2], environ)) {
+            perror(argv[2]);
+            return 1;
+        }
+        waitpid(pid, &status, 0);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            fprintf(stderr, "%s failed\n", argv[2]);
+            return 1;
+        }
+        times[i] = (end.tv_sec - start.tv_sec) * 1e6 +
+                   (end.tv_nsec - start.tv_nsec) / 1e3;
+    }
+    qsort(times, n, sizeof(*times), cmp);
+    printf("%.0f %.0f\n", times[n / 2], times[n * 99 / 100]);
+    return 0;
+}
+EOF
+$CC -O2 $TMP/bench-exec.c -o $TMP/bench-exec
+
+# Set up a directory, mirroring $1, where the tool named $2 is a link to $3.
+# This allows comparing different implementations of the same wrapper.
+mirror() {
+    mkdir -p "$TMP/$4"
+    for i in "$1"/*; do
+        ln -sf "$i" "$TMP/$4/"
+    done
+    ln -sf "$1/$3" "$TMP/$4/$2"
+    echo "$TMP/$4/$2"
+}
+
+syscalls() {
+    if ! command -v strace >/dev/null; then
+        echo -
+        return
+    fi
+    strace -f -qq -o $TMP/strace.log "$@" >/dev/null 2>&1
+    grep -v -e '+++ ' -e '--- ' $TMP/strace.log | wc -l | tr -d ' '
+}
+
+allocated() {
+    if ! command -v valgrind >/dev/null; then
+        echo -
+        return
+    fi
+    valgrind --trace-children=yes --log-file=$TMP/valgrind.%p.log "$@" >/dev/null 2>&1
+    cat $TMP/valgrind.*.log | sed -n 's/.*total heap usage:.* frees, \([0-9,]*\) bytes allocated/\1/p' | tr -d , | awk '{ sum += $1 } END { print sum + 0 }'
+    rm -f $TMP/valgrind.*.log
+}
+
+bench() {
+    name="$1"
+    shift
+    result=$($TMP/bench-exec $ITERATIONS "$@")
+    p50=${result% *}
+    p99=${result#* }
+    printf '%-32s %10s %10s %10s %14s\n' "$name" $p50 $p99 "$(syscalls "$@")" "$(allocated "$@")"
+}
+
+header() {
+    echo
+    echo "$1 ($ITERATIONS iterations)"
+    printf '%-32s %10s %10s %10s %14s\n' "" "p50 (us)" "p99 (us)" "syscalls" "bytes alloc"
+}
+
+BIN="$PREFIX/bin"
+header "$BIN"
+bench "clang" "$BIN/clang" -target $TARGET -dumpmachine
+bench "$TARGET-clang (c)" "$(mirror "$BIN" $TARGET-clang clang-target-wrapper native)" -dumpmachine
+bench "$TARGET-clang (sh)" "$(mirror "$BIN" $TARGET-clang clang-target-wrapper.sh sh)" -dumpmachine
+bench "llvm-ar" "$BIN/llvm-ar" --version
+bench "$TARGET-ar (c)" "$(mirror "$BIN" $TARGET-ar llvm-wrapper native)" --version
+bench "ld.lld" "$BIN/ld.lld" -m $M --version
+bench "$TARGET-ld (c)" "$(mirror "$BIN" $TARGET-ld ld-wrapper native)" --version
+bench "$TARGET-ld (sh)" "$(mirror "$BIN" $TARGET-ld ld-wrapper.sh sh)" --version
+
+if [ -n "$WINE_PREFIX_DIRS" ]; then
+    # Keep the wineserver running, to avoid measuring its startup.
+    wineserver -p 2>/dev/null || true
+fi
+for dir in $WINE_PREFIX_DIRS; do
+    BIN="$dir/bin"
+    CLANG_EXE=$(cd "$BIN" && ls clang-[0-9]*.exe | head -n 1)
+    header "$BIN (wine)"
+    bench "$CLANG_EXE" $WINE "$BIN/$CLANG_EXE" -target $TARGET -dumpmachine
+    bench "$TARGET-clang.exe" $WINE "$BIN/$TARGET-clang.exe" -dumpmachine
+    bench "llvm-ar.exe" $WINE "$BIN/llvm-ar.exe" --version
+    bench "$TARGET-ar.exe" $WINE "$BIN/$TARGET-ar.exe" --version
+    bench "ld.lld.exe" $WINE "$BIN/ld.lld.exe" -m $M --version
+    bench "$TARGET-ld.exe" $WINE "$BIN/$TARGET-ld.exe" --version
+done
+
+TEST="$(cd "$(dirname "$0")" && pwd)/test"
+
+# Tell whether compiling with the given command used the precompiled
+# windows.h ("yes"), whether clang rejected it ("rejected"), or whether
+# the wrapper didn't try to use it ("no"), based on the number of clang
+# invocations logged, and their number of arguments, compared to
+# compiling without LLVM_MINGW_WINDOWS_PCH set.
+pch_used() {
+    rm -f $TMP/pch.log
+    LLVM_MINGW_LOG=$TMP/pch.log "$@" >/dev/null 2>&1
+    base_argc=$(sed -n 's/.*"argc":\([0-9]*\).*/\1/p' $TMP/pch.log)
+    rm -f $TMP/pch.log
+    LLVM_MINGW_LOG=$TMP/pch.log LLVM_MINGW_WINDOWS_PCH=1 "$@" >/dev/null 2>&1
+    if [ $(wc -l < $TMP/pch.log) -gt 1 ]; then
+        echo rejected
+    elif [ $(sed -n 's/.*"argc":\([0-9]*\).*/\1/p' $TMP/pch.log) -gt $base_argc ]; then
+        echo yes
+    else
+        echo no
+    fi
+    rm -f $TMP/pch.log
+}
+
+# Compare compiling the sources listed in $COMPILE_SOURCES (one per line,
+# a path followed by any extra options for it), without and with the
+# environment variable $2 and options $3 set. If $4 is set, also show
+# whether the precompiled windows.h was used. Compiling is much slower
+# than the trivial invocations above, so do fewer iterations, and skip
+# counting syscalls and allocations.
+bench_compile() {
+    COMPILE_ITERATIONS=$(( (ITERATIONS + 99) / 100 ))
+    BIN="$PREFIX/bin"
+    echo
+    echo "$1 ($COMPILE_ITERATIONS iterations)"
+    printf '%-44s %10s %10s %10s %10s %8s\n' "" "p50 (us)" "p99 (us)" "new p50" "new p99" "${4:+pch}"
+    echo "$COMPILE_SOURCES" | while read -r src flags; do
+        [ -n "$src" ] || continue
+        case $src in
+        *.c) CC_EXE=$TARGET-clang ;;
+        *) CC_EXE=$TARGET-clang++ ;;
+        esac
+        result=$($TMP/bench-exec $COMPILE_ITERATIONS "$BIN/$CC_EXE" $flags -c "$src" -o $TMP/out.o)
+        new_result=$($TMP/bench-exec $COMPILE_ITERATIONS env $2 "$BIN/$CC_EXE" $3 $flags -c "$src" -o $TMP/out.o)
+        used=""
+        if [ -n "$4" ]; then
+            used=$(pch_used "$BIN/$CC_EXE" $flags -c "$src" -o $TMP/out.o)
+        fi
+        printf '%-44s %10s %10s %10s %10s %8s\n' "$(basename "$src") $flags" ${result% *} ${result#* } ${new_result% *} ${new_result#* } "$used"
+    done
+}
+
+if [ -n "$WINDOWS_PCH" ]; then
+    # Sources that start by including windows.h qualify for using the
+    # precompiled header. tlstest-main.cpp defines WIN32_LEAN_AND_MEAN
+    # before including it; compile a copy without that, with the define
+    # on the command line instead.
+    grep -v '^#define WIN32_LEAN_AND_MEAN' "$TEST/tlstest-main.cpp" > $TMP/tlstest-main.cpp
+    COMPILE_SOURCES="$TEST/hello-tls.c -O0
+$TEST/hello-tls.c -O2
+$TEST/hello-tls.c -O0 -DUNICODE -D_UNICODE
+$TEST/uwp-error.c -O0
+$TMP/tlstest-main.cpp -O0 -DWIN32_LEAN_AND_MEAN
+$TMP/tlstest-main.cpp -O2 -DWIN32_LEAN_AND_MEAN"
+    bench_compile "Compiling with precompiled windows.h" LLVM_MINGW_WINDOWS_PCH=1 "" 1
+fi
+if [ -n "$MODULES" ]; then
+    COMPILE_SOURCES=""
+    for src in hello-tls.c hello-res.c tlstest-main.cpp tlstest-lib.cpp; do
+        COMPILE_SOURCES="$COMPILE_SOURCES
+$TEST/$src -O0"
+    done
+    # The first iteration populates the module cache; the p50 shows the
+    # time for compiling with the modules already built.
+    bench_compile "Compiling with implicit modules" "" "-fmodules -fmodules-cache-path=$TMP/modules -fmodule-map-file=$PREFIX/$ARCH-w64-mingw32/include/windows.modulemap"
+fi
+if [ -n "$STAT_CACHE" ]; then
+    BIN="$PREFIX/bin"
+    STAT_CACHE_FLAGS=""
+    for cache in include resource-include; do
+        STAT_CACHE_FLAGS="$STAT_CACHE_FLAGS -ivfsstatcache $PREFIX/$ARCH-w64-mingw32/lib/statcache/$cache.statcache"
+    done
+    echo
+    echo "Compiling hello-cpp.cpp with stat caches"
+    printf '%-32s %10s %10s\n' "" "syscalls" "file stats"
+    for name in without with; do
+        flags=""
+        [ $name = without ] || flags="$STAT_CACHE_FLAGS"
+        strace -f -qq -o $TMP/strace.log "$BIN/clang++" -target $TARGET $flags -c "$TEST/hello-cpp.cpp" -o $TMP/out.o
+        printf '%-32s %10s %10s\n' "$name stat cache" \
+            $(grep -v -e '+++ ' -e '--- ' $TMP/strace.log | wc -l) \
+            $(grep -E -c '(^|[0-9] )(stat|lstat|fstatat|newfstatat|statx|access|faccessat|faccessat2|open|openat|readlink)\(' $TMP/strace.log)
+    done
+fi
+if [ -n "$DRIVER_LAYOUT" ]; then
+    BIN="$PREFIX/bin"
+    ITERATIONS=$(( (ITERATIONS + 9) / 10 ))
+    echo "int x;" > $TMP/empty.c
+    header "Compiling an empty file"
+    bench "clang (search)" "$BIN/clang" -target $TARGET -c $TMP/empty.c -o $TMP/out.o
+    bench "clang (explicit)" "$BIN/clang" --no-default-config --config="$BIN/$ARCH-w64-windows-gnu.cfg" --sysroot="$PREFIX" -target $TARGET -c $TMP/empty.c -o $TMP/out.o
+    bench "$TARGET-clang" "$BIN/$TARGET-clang" -c $TMP/empty.c -o $TMP/out.o
+fi
+if [ -n "$THINLTO_RELINK" ]; then
+    BIN="$PREFIX/bin"
+    CC_EXE="$BIN/$TARGET-clang"
+    mkdir -p $TMP/lto
+    OBJS=""
+    for src in "$THINLTO_RELINK"/*.c; do
+        obj=$TMP/lto/$(basename "$src" .c).o
+        "$CC_EXE" -O2 -flto=thin -I"$THINLTO_RELINK" $THINLTO_CFLAGS -c "$src" -o $obj
+        OBJS="$OBJS $obj"
+    done
+    : ${THINLTO_CHANGED:=$(ls "$THINLTO_RELINK"/*.c | head -n 1)}
+    CHANGED_OBJ=$TMP/lto/$(basename "$THINLTO_CHANGED" .c).o
+    echo
+    echo "Relinking with ThinLTO after changing $(basename "$THINLTO_CHANGED")"
+    printf '%-32s %10s\n' "" "time (us)"
+    for name in without with; do
+        cache=""
+        [ $name = without ] || cache=$TMP/lto-cache
+        # Do an initial link, to populate the cache.
+        LLVM_MINGW_THINLTO_CACHE=$cache "$CC_EXE" -O2 -flto=thin $OBJS -o $TMP/lto.exe
+        # Add a new function to the changed source, to make it actually
+        # produce a different module.
+        (cat "$THINLTO_CHANGED"; echo "int bench_relink_changed_$$(void) { return ${#name}; }") > $TMP/changed.c
+        "$CC_EXE" -O2 -flto=thin -I"$THINLTO_RELINK" $THINLTO_CFLAGS -c $TMP/changed.c -o $CHANGED_OBJ
+        result=$(LLVM_MINGW_THINLTO_CACHE=$cache $TMP/bench-exec 1 "$CC_EXE" -O2 -flto=thin $OBJS -o $TMP/lto.exe)
+        printf '%-32s %10s\n' "$name cache" ${result% *}
+    done
+fi
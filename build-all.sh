@@ -73,6 +73,15 @@ while [ $# -gt 0 ]; do
     --clean-runtimes)
         CLEAN_RUNTIMES=1
         ;;
+    --skip-unchanged)
+        SKIP_UNCHANGED=1
+        ;;
+    --parallel-runtimes)
+        PARALLEL_RUNTIMES=1
+        ;;
+    --unified-runtimes)
+        UNIFIED_RUNTIMES=1
+        ;;
     --llvm-only)
         LLVM_ONLY=1
         ;;
@@ -120,7 +129,7 @@ while [ $# -gt 0 ]; do
     shift
 done
 if [ -z "$PREFIX" ]; then
-    echo "$0 [--host-clang[=clang]] [--enable-asserts] [--disable-dylib] [--with-clang] [--use-linker=linker] [--thinlto] [--full-llvm] [--disable-lldb] [--disable-lldb-mi] [--disable-clang-tools-extra] [--host=triple] [--with-default-win32-winnt=0x601] [--with-default-msvcrt=ucrt] [--enable-cfguard|--disable-cfguard] [--no-runtimes] [--llvm-only] [--no-tools] [--wipe-runtimes] [--clean-runtimes] [--stage1] [--profile[=type]] [--pgo[=profile]] [--full-pgo[=type]] dest [pgo-dest]"
+    echo "$0 [--host-clang[=clang]] [--enable-asserts] [--disable-dylib] [--with-clang] [--use-linker=linker] [--thinlto] [--full-llvm] [--disable-lldb] [--disable-lldb-mi] [--disable-clang-tools-extra] [--host=triple] [--with-default-win32-winnt=0x601] [--with-default-msvcrt=ucrt] [--enable-cfguard|--disable-cfguard] [--no-runtimes] [--llvm-only] [--no-tools] [--wipe-runtimes] [--clean-runtimes] [--parallel-runtimes] [--unified-runtimes] [--skip-unchanged] [--stage1] [--profile[=type]] [--pgo[=profile]] [--full-pgo[=type]] dest [pgo-dest]"
     exit 1
 fi
 if [ -n "$PREFIX_PGO" ] && [ -z "$PGO" ] && [ -z "$FULL_PGO" ]; then
@@ -144,7 +153,7 @@ if [ -n "$FULL_PGO" ]; then
         echo Must provide a second destination for a PGO build
         exit 1
     fi
-    ./build-all.sh "$PREFIX" --stage1 $LLVM_ARGS $MINGW_ARGS $CFGUARD_ARGS
+    ./build-all.sh "$PREFIX" --stage1 $LLVM_ARGS $MINGW_ARGS $CFGUARD_ARGS ${PARALLEL_RUNTIMES:+--parallel-runtimes} ${UNIFIED_RUNTIMES:+--unified-runtimes} ${SKIP_UNCHANGED:+--skip-unchanged}
     unset COMPILER_LAUNCHER
     ./build-all.sh "$PREFIX" --profile$INSTRUMENTATION $LLVM_ARGS
     ./build-all.sh "$PREFIX" "$PREFIX_PGO" --thinlto --pgo --llvm-only $LLVM_ARGS
@@ -191,34 +200,262 @@ if [ "$(uname)" = "Darwin" ]; then
     fi
 fi
 
+# Each stage below records a stamp in $STAMP_DIR after it has been built
+# successfully, hashing its inputs: the command line, the script, the
+# revision and local changes of the sources it builds, the environment
+# variables that affect the build, and the stamp of the stage before it.
+# The stamp is removed before running the stage, so a failed or
+# interrupted stage never is considered built. With --skip-unchanged, a
+# stage is skipped if its stamp is unchanged and its key outputs still
+# exist in $PREFIX.
+#
+# If BUILD_TIMELINE is set, the start and end of each stage that is run
+# is recorded there; see timeline-report.sh.
+STAMP_DIR="$PREFIX/.build-stamps"
+STAMP_VARS="ARCHS TOOLCHAIN_ARCHS TOOLCHAIN_TARGET_OSES LLVM_VERSION LLVM_REPOSITORY LLVM_CMAKEFLAGS LLDB_MI_VERSION MINGW_W64_VERSION DEFAULT_WIN32_WINNT DEFAULT_MSVCRT LIBCXX_MODULE_STDS MACOS_REDIST_ARCHS MACOS_REDIST_VERSION TOOLEXT"
+
+stage_stamp() {
+    INPUTS="$1"
+    shift
+    {
+        echo "$PREVIOUS_STAMP"
+        echo "$@"
+        for var in $STAMP_VARS; do
+            eval "echo $var=\${$var-unset}"
+        done
+        if [ -f "$1" ]; then
+            cat "$1"
+        fi
+        for input in $INPUTS; do
+            if [ -d "$input/.git" ]; then
+                git -C "$input" rev-parse HEAD
+                git -C "$input" status --porcelain --untracked-files=no
+            elif [ -d "$input" ]; then
+                cat "$input"/*
+            elif [ -f "$input" ]; then
+                cat "$input"
+            fi
+        done
+    } | git hash-object --stdin
+}
+
+# Check that the key outputs of a stage (relative to $PREFIX, as
+# patterns) still exist, before skipping it.
+stage_outputs_exist() {
+    case $1 in
+    llvm|llvm-macos-native-tools)
+        OUTPUTS="bin/clang bin/ld.lld"
+        ;;
+    lldb-mi)
+        OUTPUTS="bin/lldb-mi"
+        ;;
+    strip-llvm)
+        # Stripping modifies the outputs of the stages before it; redo it
+        # if any of them were rebuilt.
+        [ -z "$STAGE_RAN" ] || return 1
+        OUTPUTS=""
+        ;;
+    compiler-rt-native)
+        OUTPUTS="lib/clang/*/lib"
+        ;;
+    wrappers)
+        OUTPUTS="bin/*-w64-mingw32-clang"
+        ;;
+    mingw-w64-tools)
+        OUTPUTS="bin/*-w64-mingw32-widl"
+        ;;
+    runtimes-mingw-w64)
+        OUTPUTS="*-w64-mingw32/lib/libmingw32.a"
+        ;;
+    runtimes-compiler-rt)
+        OUTPUTS="lib/clang/*/lib/windows/libclang_rt.builtins-*"
+        ;;
+    runtimes-libcxx)
+        OUTPUTS="*-w64-mingw32/lib/libc++*"
+        ;;
+    runtimes-mingw-w64-libraries)
+        OUTPUTS="*-w64-mingw32/lib/libwinpthread*"
+        ;;
+    runtimes-openmp)
+        OUTPUTS="*-w64-mingw32/lib/libomp*"
+        ;;
+    runtimes-all)
+        OUTPUTS="*-w64-mingw32/lib/libmingw32.a lib/clang/*/lib/windows/libclang_rt.builtins-* *-w64-mingw32/lib/libc++* *-w64-mingw32/lib/libwinpthread*"
+        ;;
+    *)
+        # E.g. the sanitizers, which aren't installed for all arches.
+        OUTPUTS=""
+        ;;
+    esac
+    for output in $OUTPUTS; do
+        set -- "$PREFIX"/$output
+        [ -e "$1" ] || [ -e "$1.exe" ] || return 1
+    done
+    return 0
+}
+
+run_stage() {
+    NAME="$1"
+    INPUTS="$2"
+    shift 2
+    if [ -n "$SKIP_UNCHANGED" ]; then
+        STAMP="$(stage_stamp "$INPUTS" "$@")"
+        if [ "$(cat "$STAMP_DIR/$NAME" 2>/dev/null)" = "$STAMP" ]; then
+            if stage_outputs_exist "$NAME"; then
+                echo "Skipping $NAME, inputs unchanged"
+                PREVIOUS_STAMP="$STAMP"
+                return
+            fi
+            echo "Rebuilding $NAME, as its outputs are missing or outdated"
+        fi
+    fi
+    rm -f "$STAMP_DIR/$NAME"
+    STAGE_RAN=1
+    if [ -n "$REMOVE_HEADER_CACHES" ]; then
+        # Remove the stat caches and precompiled headers for the headers,
+        # which would be outdated when the headers are updated below.
+        rm -rf $PREFIX/*-w64-mingw32/lib/statcache $PREFIX/*-w64-mingw32/lib/pch
+        REMOVE_HEADER_CACHES=
+        BUILD_HEADER_CACHES=1
+    fi
+    if [ -f "$1" ]; then
+        ./timeline.sh "$NAME" "$@"
+    else
+        # The parallel runtimes build records its steps in the timeline
+        # itself.
+        "$@"
+    fi
+    # Only reached if the stage succeeded, as the script runs with set -e.
+    # Calculate the stamp after running the stage, as it may have updated
+    # the sources.
+    STAMP="$(stage_stamp "$INPUTS" "$@")"
+    mkdir -p "$STAMP_DIR"
+    echo "$STAMP" > "$STAMP_DIR/$NAME"
+    PREVIOUS_STAMP="$STAMP"
+}
+
+# Quote a string as a single shell word, for use in a makefile recipe.
+make_quote() {
+    printf "'%s'" "$(printf '%s' "$1" | sed -e "s/'/'\\\\''/g" -e 's/\$/$$/g')"
+}
+
+build_runtimes_parallel() {
+    # Build the runtimes for all arches at once, as a dependency graph
+    # run by make, instead of one arch at a time for each runtime. The
+    # runtime builds take their jobs from the jobserver of this make,
+    # sharing one limit of $CORES jobs, so that other arches can make use
+    # of cores that would be idle during configure and install steps.
+    #
+    # The headers that are shared between all arches (the mingw-w64 and
+    # libc++ ones) are installed once, before building anything that
+    # uses them, so that no build reads them while they are rewritten.
+    # The sanitizer headers (in the clang resource directory) are only
+    # installed by the sanitizer build of the first arch.
+    : ${CORES:=$(nproc 2>/dev/null)}
+    : ${CORES:=$(sysctl -n hw.ncpu 2>/dev/null)}
+    : ${CORES:=4}
+    : ${ARCHS:=${TOOLCHAIN_ARCHS-i686 x86_64 armv7 aarch64 arm64ec}}
+
+    MAKE=make
+    if command -v gmake >/dev/null; then
+        MAKE=gmake
+    fi
+    case $(uname) in
+    Darwin)
+        ;;
+    *)
+        # Assume everything except macOS has got GNU make >= 4.0. Keep
+        # the output of the concurrent builds from being mixed within
+        # lines, without holding it back until each build has finished.
+        MAKEOPTS="-Oline"
+    esac
+    if command -v ninja >/dev/null; then
+        case "$(ninja --version)" in
+        1.[0-9]|1.[0-9].*|1.1[0-2]|1.1[0-2].*)
+            echo "warning: ninja older than 1.13 doesn't use the make jobserver; each CMake based runtime build will use all cores." 1>&2
+            ;;
+        esac
+    fi
+
+    # Check out the sources once before starting, instead of from the
+    # individual scripts, which otherwise would do it concurrently.
+    CHECKOUT_ONLY=1 ./build-llvm.sh
+    CHECKOUT_ONLY=1 ./build-mingw-w64.sh
+
+    RUNTIMES_MAKEFILE="$(mktemp)"
+    trap 'rm -f "$RUNTIMES_MAKEFILE"' 0
+    QPREFIX="$(make_quote "$PREFIX")"
+    set -- $ARCHS
+    FIRST_ARCH=$1
+    {
+        TARGETS="headers libcxx-headers"
+        echo "headers:"
+        printf '\t+./timeline.sh headers ./build-mingw-w64.sh --headers-only %s%s %s\n' "$QPREFIX" "$MINGW_ARGS" "$CFGUARD_ARGS"
+        # Configuring libc++ requires a working compiler for the target.
+        echo "libcxx-headers: compiler-rt-$FIRST_ARCH"
+        printf '\t+ARCHS=%s ./timeline.sh libcxx-headers ./build-libcxx.sh --headers-only %s %s\n' $FIRST_ARCH "$QPREFIX" "$CFGUARD_ARGS"
+        for arch in $ARCHS; do
+            # The arm64ec builtins get merged into the aarch64 ones.
+            DEPS=""
+            if [ "$arch" = "arm64ec" ]; then
+                DEPS="compiler-rt-aarch64"
+            fi
+            echo "crt-$arch: headers"
+            printf '\t+ARCHS=%s ./timeline.sh crt-%s ./build-mingw-w64.sh --skip-headers %s%s %s\n' $arch $arch "$QPREFIX" "$MINGW_ARGS" "$CFGUARD_ARGS"
+            echo "compiler-rt-$arch: crt-$arch $DEPS"
+            printf '\t+ARCHS=%s ./timeline.sh compiler-rt-%s ./build-compiler-rt.sh %s %s\n' $arch $arch "$QPREFIX" "$CFGUARD_ARGS"
+            echo "libcxx-$arch: compiler-rt-$arch libcxx-headers"
+            printf '\t+ARCHS=%s ./timeline.sh libcxx-%s ./build-libcxx.sh --skip-headers %s %s %s\n' $arch $arch "$QPREFIX" "$CFGUARD_ARGS" "$LIBCXX_ARGS"
+            echo "libraries-$arch: compiler-rt-$arch"
+            printf '\t+ARCHS=%s ./timeline.sh libraries-%s ./build-mingw-w64-libraries.sh %s %s\n' $arch $arch "$QPREFIX" "$CFGUARD_ARGS"
+            # CFGUARD_ARGS intentionally omitted
+            SANITIZER_ARGS=--build-sanitizers
+            if [ "$arch" != "$FIRST_ARCH" ]; then
+                SANITIZER_ARGS="$SANITIZER_ARGS --skip-headers"
+            fi
+            echo "sanitizers-$arch: libcxx-$arch libraries-$arch"
+            printf '\t+ARCHS=%s ./timeline.sh sanitizers-%s ./build-compiler-rt.sh %s %s\n' $arch $arch "$QPREFIX" "$SANITIZER_ARGS"
+            TARGETS="$TARGETS crt-$arch compiler-rt-$arch libcxx-$arch libraries-$arch sanitizers-$arch"
+            if [ -z "$UNIFIED_RUNTIMES" ]; then
+                echo "openmp-$arch: libcxx-$arch libraries-$arch"
+                printf '\t+ARCHS=%s ./timeline.sh openmp-%s ./build-openmp.sh %s %s\n' $arch $arch "$QPREFIX" "$CFGUARD_ARGS"
+                TARGETS="$TARGETS openmp-$arch"
+            fi
+        done
+        echo "all: $TARGETS"
+        echo ".PHONY: all $TARGETS"
+    } > "$RUNTIMES_MAKEFILE"
+    USE_JOBSERVER=1 SYNC= $MAKE -f "$RUNTIMES_MAKEFILE" -j$CORES $MAKEOPTS all
+}
+
 if [ -z "$NO_TOOLS" ]; then
     if [ -z "${HOST_CLANG}" ]; then
-        ./build-llvm.sh $PREFIX $LLVM_ARGS $HOST_ARGS
+        run_stage llvm llvm-project ./build-llvm.sh $PREFIX $LLVM_ARGS $HOST_ARGS
         if [ -n "$PROFILE" ]; then
-            ./pgo-training.sh llvm-project/llvm/build-instrumented $STAGE1_PREFIX
+            ./timeline.sh pgo-training ./pgo-training.sh llvm-project/llvm/build-instrumented $STAGE1_PREFIX
             exit 0
         fi
         if [ -z "$NO_LLDB" ] && [ -z "$NO_LLDB_MI" ]; then
-            ./build-lldb-mi.sh $PREFIX $HOST_ARGS
+            run_stage lldb-mi lldb-mi ./build-lldb-mi.sh $PREFIX $HOST_ARGS
         fi
         if [ -z "$FULL_LLVM" ]; then
-            ./strip-llvm.sh $PREFIX $HOST_ARGS
+            run_stage strip-llvm "" ./strip-llvm.sh $PREFIX $HOST_ARGS
         fi
         if [ -n "$STAGE1" ]; then
             if [ "$(uname)" = "Darwin" ]; then
-                ./build-llvm.sh $PREFIX --macos-native-tools
+                run_stage llvm-macos-native-tools llvm-project ./build-llvm.sh $PREFIX --macos-native-tools
             fi
             # Build runtimes. On Linux, this is needed for profiling.
             # On macOS, it is also needed for OS availability helpers like
             # __isPlatformVersionAtLeast.
-            ./build-compiler-rt.sh --native $PREFIX
+            run_stage compiler-rt-native llvm-project ./build-compiler-rt.sh --native $PREFIX
         fi
     fi
     if [ -n "$LLVM_ONLY" ]; then
         exit 0
     fi
-    ./install-wrappers.sh $PREFIX $HOST_ARGS ${HOST_CLANG:+--host-clang=$HOST_CLANG}
-    ./build-mingw-w64-tools.sh $PREFIX $HOST_ARGS
+    run_stage wrappers wrappers ./install-wrappers.sh $PREFIX $HOST_ARGS ${HOST_CLANG:+--host-clang=$HOST_CLANG}
+    run_stage mingw-w64-tools mingw-w64 ./build-mingw-w64-tools.sh $PREFIX $HOST_ARGS
 fi
 if [ -n "$NO_RUNTIMES" ]; then
     exit 0
@@ -229,13 +466,34 @@ if [ -n "$WIPE_RUNTIMES" ]; then
     # This roughly matches the setup as if --no-runtimes had been passed,
     # except that compiler-rt headers are left installed in lib/clang/*/include.
     rm -rf $PREFIX/*-w64-mingw32 $PREFIX/lib/clang/*/lib
+    rm -f "$STAMP_DIR"/runtimes-*
 fi
 if [ -n "$CLEAN_RUNTIMES" ]; then
     export CLEAN=1
+    rm -f "$STAMP_DIR"/runtimes-*
+fi
+# The stat caches and precompiled headers are removed before building any
+# of the runtimes, and rebuilt afterwards.
+REMOVE_HEADER_CACHES=1
+if [ -n "$UNIFIED_RUNTIMES" ]; then
+    # Build openmp in the same runtimes build as libc++.
+    LIBCXX_ARGS="--with-openmp"
+fi
+RUNTIMES_START=$(date +%s)
+if [ -n "$PARALLEL_RUNTIMES" ]; then
+    run_stage runtimes-all "llvm-project mingw-w64 build-all.sh build-mingw-w64.sh build-compiler-rt.sh build-libcxx.sh build-mingw-w64-libraries.sh build-openmp.sh" build_runtimes_parallel
+else
+    run_stage runtimes-mingw-w64 mingw-w64 ./build-mingw-w64.sh $PREFIX $MINGW_ARGS $CFGUARD_ARGS
+    run_stage runtimes-compiler-rt llvm-project ./build-compiler-rt.sh $PREFIX $CFGUARD_ARGS
+    run_stage runtimes-libcxx llvm-project ./build-libcxx.sh $PREFIX $CFGUARD_ARGS $LIBCXX_ARGS
+    run_stage runtimes-mingw-w64-libraries mingw-w64 ./build-mingw-w64-libraries.sh $PREFIX $CFGUARD_ARGS
+    run_stage runtimes-sanitizers llvm-project ./build-compiler-rt.sh $PREFIX --build-sanitizers # CFGUARD_ARGS intentionally omitted
+    if [ -z "$UNIFIED_RUNTIMES" ]; then
+        run_stage runtimes-openmp llvm-project ./build-openmp.sh $PREFIX $CFGUARD_ARGS
+    fi
+fi
+echo "Built the runtimes in $(($(date +%s) - RUNTIMES_START)) seconds"
+if [ -n "$BUILD_HEADER_CACHES" ]; then
+    ./timeline.sh stat-cache ./build-stat-cache.sh $PREFIX
+    ./timeline.sh windows-pch ./build-windows-pch.sh $PREFIX
 fi
-./build-mingw-w64.sh $PREFIX $MINGW_ARGS $CFGUARD_ARGS
-./build-compiler-rt.sh $PREFIX $CFGUARD_ARGS
-./build-libcxx.sh $PREFIX $CFGUARD_ARGS
-./build-mingw-w64-libraries.sh $PREFIX $CFGUARD_ARGS
-./build-compiler-rt.sh $PREFIX --build-sanitizers # CFGUARD_ARGS intentionally omitted
-./build-openmp.sh $PREFIX $CFGUARD_ARGS
@@ -43,13 +43,19 @@ while [ $# -gt 0 ]; do
     elif [ "$1" = "--native" ]; then
         NATIVE=1
         SRC_DIR=..
+    elif [ "$1" = "--skip-headers" ]; then
+        # Don't install the sanitizer headers and data files, which are
+        # shared between all arches; build-all.sh --parallel-runtimes
+        # installs them from one arch only, to avoid several builds
+        # rewriting them concurrently.
+        SKIP_HEADERS=1
     else
         PREFIX="$1"
     fi
     shift
 done
 if [ -z "$PREFIX" ]; then
-    echo "$0 [--build-sanitizers] [--enable-cfguard|--disable-cfguard] [--native] dest"
+    echo "$0 [--build-sanitizers [--skip-headers]] [--enable-cfguard|--disable-cfguard] [--native] dest"
     exit 1
 fi
 if [ -n "$SANITIZERS" ] && [ -n "$ENABLE_CFGUARD" ]; then
@@ -81,18 +87,25 @@ else
         ;;
     esac
 fi
+if [ -n "$USE_JOBSERVER" ]; then
+    # Running from build-all.sh --parallel-runtimes; let the build tool
+    # take the jobs from the jobserver of the parent make instead.
+    unset CORES
+fi
 
-cat<<EOF > is-ucrt.c
+# Use a separate file per process, as build-all.sh --parallel-runtimes
+# can run multiple instances of this script at once.
+cat<<EOF > is-ucrt-$$.c
 #include <corecrt.h>
 #if !defined(_UCRT)
 #error not ucrt
 #endif
 EOF
 ANY_ARCH=$(echo $ARCHS | awk '{print $1}')
-if $ANY_ARCH-w64-mingw32-gcc$TOOLEXT -E is-ucrt.c > /dev/null 2>&1; then
+if $ANY_ARCH-w64-mingw32-gcc$TOOLEXT -E is-ucrt-$$.c > /dev/null 2>&1; then
     IS_UCRT=1
 fi
-rm -f is-ucrt.c
+rm -f is-ucrt-$$.c
 
 cd llvm-project/compiler-rt
 
@@ -134,15 +147,33 @@ if [ -n "$NATIVE" ]; then
     exit 0
 fi
 
+# Any stat caches from build-stat-cache.sh (which cover the clang resource
+# headers for all arches) would be outdated once the sanitizer headers are
+# reinstalled.
+if [ -z "$SKIP_HEADERS" ]; then
+    rm -rf "$PREFIX"/*-w64-mingw32/lib/statcache
+fi
+
 for arch in $ARCHS; do
     [ -z "$CLEAN" ] || rm -rf build-$arch$BUILD_SUFFIX
     mkdir -p build-$arch$BUILD_SUFFIX
     cd build-$arch$BUILD_SUFFIX
     [ -n "$NO_RECONF" ] || rm -rf CMake*
+    # For the sanitizers, always set where to install the headers and
+    # data files, as the cache may remain from a build with --skip-headers,
+    # when building with NO_RECONF.
+    INCLUDE_DIR=include
+    DATA_DIR=share
+    if [ -n "$SKIP_HEADERS" ]; then
+        INCLUDE_DIR="$(pwd)/skipped-install/include"
+        DATA_DIR="$(pwd)/skipped-install/share"
+    fi
     cmake \
         ${CMAKE_GENERATOR+-G} "$CMAKE_GENERATOR" \
         -DCMAKE_BUILD_TYPE=Release \
         -DCMAKE_INSTALL_PREFIX="$CLANG_RESOURCE_DIR" \
+        ${SANITIZERS:+"-DCOMPILER_RT_INSTALL_INCLUDE_DIR=$INCLUDE_DIR"} \
+        ${SANITIZERS:+"-DCOMPILER_RT_INSTALL_DATA_DIR=$DATA_DIR"} \
         -DCMAKE_C_COMPILER=$arch-w64-mingw32-clang \
         -DCMAKE_CXX_COMPILER=$arch-w64-mingw32-clang++ \
         -DCMAKE_SYSTEM_NAME=Windows \
@@ -190,7 +221,12 @@ for arch in $ARCHS; do
                 rm -f "$INSTALL_PREFIX/lib/windows/libclang_rt.asan"*arm*
                 ;;
             *)
-                mv "$INSTALL_PREFIX/lib/windows/"*.dll "$PREFIX/$arch-w64-mingw32/bin"
+                # Only move the DLLs for this arch; with build-all.sh
+                # --parallel-runtimes, other arches may be installed
+                # concurrently.
+                RT_ARCH=$arch
+                [ "$arch" != "i686" ] || RT_ARCH=i386
+                mv "$INSTALL_PREFIX/lib/windows/"*-$RT_ARCH.dll "$PREFIX/$arch-w64-mingw32/bin"
                 ;;
             esac
         fi
@@ -202,13 +238,18 @@ done
 # in Clang, the current approach mirrors MSVC, where the core CRT is provided as
 # archives containing both EC and native support. Ideally, the LLVM build system would
 # handle this automatically, but for now we can merge it here.
+# The merged archive is written to a temporary file and renamed into place,
+# as aarch64 builds may be linking against the existing one concurrently,
+# with build-all.sh --parallel-runtimes.
 for arch in $ARCHS; do
     if [ "$arch" = "arm64ec" ]; then
-        rm -f "$INSTALL_PREFIX/lib/windows/libclang_rt.builtins-aarch64.a" \
+        rm -f "$INSTALL_PREFIX/lib/windows/libclang_rt.builtins-aarch64.a.tmp" \
               "$INSTALL_PREFIX/lib/windows/libclang_rt.builtins-arm64ec.a"
-        "$PREFIX/bin/llvm-lib" -machine:arm64ec "-out:$INSTALL_PREFIX/lib/windows/libclang_rt.builtins-aarch64.a" \
+        "$PREFIX/bin/llvm-lib" -machine:arm64ec "-out:$INSTALL_PREFIX/lib/windows/libclang_rt.builtins-aarch64.a.tmp" \
                                build-aarch64/lib/windows/libclang_rt.builtins-aarch64.a \
                                build-arm64ec/lib/windows/libclang_rt.builtins-arm64ec.a
+        mv "$INSTALL_PREFIX/lib/windows/libclang_rt.builtins-aarch64.a.tmp" \
+           "$INSTALL_PREFIX/lib/windows/libclang_rt.builtins-aarch64.a"
     fi
 done
 
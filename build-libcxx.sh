@@ -33,13 +33,19 @@ while [ $# -gt 0 ]; do
         CFGUARD_CFLAGS="-mguard=cf"
     elif [ "$1" = "--disable-cfguard" ]; then
         CFGUARD_CFLAGS=
+    elif [ "$1" = "--with-openmp" ]; then
+        WITH_OPENMP=1
+    elif [ "$1" = "--headers-only" ]; then
+        HEADERS_ONLY=1
+    elif [ "$1" = "--skip-headers" ]; then
+        SKIP_HEADERS=1
     else
         PREFIX="$1"
     fi
     shift
 done
 if [ -z "$PREFIX" ]; then
-    echo "$0 [--disable-shared] [--disable-static] [--enable-cfguard|--disable-cfguard] dest"
+    echo "$0 [--disable-shared] [--disable-static] [--enable-cfguard|--disable-cfguard] [--with-openmp] [--headers-only|--skip-headers] dest"
     exit 1
 fi
 
@@ -49,6 +55,28 @@ PREFIX="$(cd "$PREFIX" && pwd)"
 export PATH="$PREFIX/bin:$PATH"
 
 : ${ARCHS:=${TOOLCHAIN_ARCHS-i686 x86_64 armv7 aarch64 arm64ec}}
+# Language modes to prebuild the std and std.compat modules for.
+: ${LIBCXX_MODULE_STDS:=c++23 gnu++23}
+
+# The headers (and the module sources) are installed into directories
+# shared by all arches. With --headers-only, only install them, from a
+# configuration for the first arch; with --skip-headers, don't install
+# them. build-all.sh --parallel-runtimes uses these to install the headers
+# once, before building for all arches at the same time.
+INSTALL_HEADERS=ON
+if [ -n "$HEADERS_ONLY" ]; then
+    set -- $ARCHS
+    ARCHS=$1
+elif [ -n "$SKIP_HEADERS" ]; then
+    INSTALL_HEADERS=OFF
+fi
+
+# If collecting time traces, the builds below run in different directories;
+# use an absolute path for them.
+if [ -n "$LLVM_MINGW_TIME_TRACE" ]; then
+    mkdir -p "$LLVM_MINGW_TIME_TRACE"
+    export LLVM_MINGW_TIME_TRACE="$(cd "$LLVM_MINGW_TIME_TRACE" && pwd)"
+fi
 
 if [ ! -d llvm-project/libunwind ] || [ -n "$SYNC" ]; then
     CHECKOUT_ONLY=1 ./build-llvm.sh
@@ -71,11 +99,32 @@ else
         ;;
     esac
 fi
+if [ -n "$USE_JOBSERVER" ]; then
+    # Running from build-all.sh --parallel-runtimes; let the build tool
+    # take the jobs from the jobserver of the parent make instead.
+    unset CORES
+fi
+
+# Compile one of the libc++ modules for $arch and $std into $MODULE_DIR.
+# Invoke clang directly with the same config file as the wrappers, as the
+# wrappers would add options for the directory being populated here.
+compile_module() {
+    module=$1
+    shift
+    "$PREFIX/bin/clang" --driver-mode=g++ --no-default-config \
+        --config="$PREFIX/bin/$arch-w64-windows-gnu.cfg" --sysroot="$PREFIX" \
+        -std=$std -I"$PREFIX/share/libc++/v1" -Wno-reserved-module-identifier \
+        -Xclang -fmodules-embed-all-files $CFGUARD_CFLAGS "$@" \
+        -x c++-module -c "$PREFIX/share/libc++/v1/$module.cppm" \
+        -fmodule-output="$MODULE_DIR/$module.pcm" -o "$MODULE_DIR/$module.o"
+}
 
 for arch in $ARCHS; do
-    [ -z "$CLEAN" ] || rm -rf build-$arch
-    mkdir -p build-$arch
-    cd build-$arch
+    BUILDDIR=build-$arch
+    [ -z "$HEADERS_ONLY" ] || BUILDDIR=build-headers
+    [ -z "$CLEAN" ] || rm -rf $BUILDDIR
+    mkdir -p $BUILDDIR
+    cd $BUILDDIR
     [ -n "$NO_RECONF" ] || rm -rf CMake*
 
     EXTRA_CFLAGS=""
@@ -87,6 +136,23 @@ for arch in $ARCHS; do
         ;;
     esac
 
+    RUNTIMES="libunwind;libcxxabi;libcxx"
+    CMAKEFLAGS=""
+    if [ -n "$WITH_OPENMP" ]; then
+        # Build openmp as part of the same runtimes build, instead of with
+        # build-openmp.sh in a separate build directory, to only run the
+        # CMake configure checks once and build everything in one graph.
+        RUNTIMES="$RUNTIMES;openmp"
+        CMAKEFLAGS="$CMAKEFLAGS -DCMAKE_RC_COMPILER=$arch-w64-mingw32-windres"
+        CMAKEFLAGS="$CMAKEFLAGS -DCMAKE_ASM_MASM_COMPILER=llvm-ml"
+        CMAKEFLAGS="$CMAKEFLAGS -DLIBOMP_ENABLE_SHARED=TRUE"
+        case $arch in
+        x86_64)
+            CMAKEFLAGS="$CMAKEFLAGS -DLIBOMP_ASMFLAGS=-m64"
+            ;;
+        esac
+    fi
+
     cmake \
         ${CMAKE_GENERATOR+-G} "$CMAKE_GENERATOR" \
         -DCMAKE_BUILD_TYPE=Release \
@@ -99,8 +165,9 @@ for arch in $ARCHS; do
         -DCMAKE_CXX_COMPILER_WORKS=TRUE \
         -DCMAKE_AR="$PREFIX/bin/llvm-ar" \
         -DCMAKE_RANLIB="$PREFIX/bin/llvm-ranlib" \
-        -DLLVM_ENABLE_RUNTIMES="libunwind;libcxxabi;libcxx" \
+        -DLLVM_ENABLE_RUNTIMES="$RUNTIMES" \
         -DLIBUNWIND_USE_COMPILER_RT=TRUE \
+        -DLIBUNWIND_INSTALL_HEADERS=$INSTALL_HEADERS \
         -DLIBUNWIND_ENABLE_SHARED=$BUILD_SHARED \
         -DLIBUNWIND_ENABLE_STATIC=$BUILD_STATIC \
         -DLIBCXX_USE_COMPILER_RT=ON \
@@ -110,18 +177,62 @@ for arch in $ARCHS; do
         -DLIBCXX_CXX_ABI=libcxxabi \
         -DLIBCXX_LIBDIR_SUFFIX="" \
         -DLIBCXX_INCLUDE_TESTS=FALSE \
-        -DLIBCXX_INSTALL_MODULES=ON \
+        -DLIBCXX_INSTALL_HEADERS=$INSTALL_HEADERS \
+        -DLIBCXX_INSTALL_MODULES=$INSTALL_HEADERS \
         -DLIBCXX_INSTALL_MODULES_DIR="$PREFIX/share/libc++/v1" \
         -DLIBCXX_ENABLE_ABI_LINKER_SCRIPT=FALSE \
         -DLIBCXXABI_USE_COMPILER_RT=ON \
         -DLIBCXXABI_USE_LLVM_UNWINDER=ON \
+        -DLIBCXXABI_INSTALL_HEADERS=$INSTALL_HEADERS \
         -DLIBCXXABI_ENABLE_SHARED=OFF \
         -DLIBCXXABI_LIBDIR_SUFFIX="" \
         -DCMAKE_C_FLAGS_INIT="$CFGUARD_CFLAGS $EXTRA_CFLAGS" \
         -DCMAKE_CXX_FLAGS_INIT="$CFGUARD_CFLAGS $EXTRA_CFLAGS" \
+        $CMAKEFLAGS \
         ..
 
+    # Any stat caches from build-stat-cache.sh and precompiled headers from
+    # build-windows-pch.sh would be outdated once the headers are
+    # reinstalled.
+    if [ -n "$HEADERS_ONLY" ]; then
+        rm -rf "$PREFIX"/*-w64-mingw32/lib/statcache "$PREFIX"/*-w64-mingw32/lib/pch
+        cmake --build . ${CORES:+-j${CORES}} --target install-unwind-headers install-cxxabi-headers install-cxx-headers install-cxx-modules
+        cd ..
+        continue
+    fi
     cmake --build . ${CORES:+-j${CORES}}
+    [ -n "$SKIP_HEADERS" ] || rm -rf "$PREFIX/$arch-w64-mingw32/lib/statcache" "$PREFIX/$arch-w64-mingw32/lib/pch"
     cmake --install .
+    if [ -n "$WITH_OPENMP" ]; then
+        rm -f $PREFIX/$arch-w64-mingw32/bin/*iomp5md*
+        rm -f $PREFIX/$arch-w64-mingw32/lib/*iomp5md*
+    fi
+
+    # Precompile the std and std.compat modules, so that "import std;"
+    # works without first having to build them in each project. The
+    # wrappers pass -fprebuilt-module-path pointing at these, when
+    # compiling with a matching -std= option. Embed the source files in
+    # the module files, so that they stay valid if the toolchain is moved.
+    #
+    # The objects built alongside contain the definitions (like the module
+    # initializers) that code importing the modules links against. These
+    # don't depend on the language mode, so the wrappers link in the ones
+    # from the first mode, from libstd-modules.a, for C++ links.
+    MODULES_LIB="$PREFIX/$arch-w64-mingw32/lib/modules/libstd-modules.a"
+    rm -f "$MODULES_LIB"
+    for std in $LIBCXX_MODULE_STDS; do
+        MODULE_DIR="$PREFIX/$arch-w64-mingw32/lib/modules/$std"
+        mkdir -p "$MODULE_DIR"
+        compile_module std
+        compile_module std.compat -fmodule-file=std="$MODULE_DIR/std.pcm"
+        if [ ! -f "$MODULES_LIB" ]; then
+            "$PREFIX/bin/llvm-ar" rcs "$MODULES_LIB" "$MODULE_DIR/std.o" "$MODULE_DIR/std.compat.o"
+        fi
+        rm -f "$MODULE_DIR/std.o" "$MODULE_DIR/std.compat.o"
+    done
     cd ..
 done
+
+if [ -n "$LLVM_MINGW_TIME_TRACE" ]; then
+    ../../time-trace-report.sh "$LLVM_MINGW_TIME_TRACE"
+fi
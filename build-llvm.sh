@@ -417,6 +417,9 @@ if [ "$INSTRUMENTED" != "OFF" ]; then
     cmake --build . ${CORES:+-j${CORES}} --target clang --target lld
 else
     cmake --build . ${CORES:+-j${CORES}}
+    # Any stat caches from build-stat-cache.sh would be outdated once the
+    # clang resource headers are reinstalled.
+    rm -rf "$PREFIX"/*-w64-mingw32/lib/statcache
     cmake --install . --strip
 
     cp ../LICENSE.TXT $PREFIX
@@ -46,6 +46,13 @@ unset CC
 : ${CORES:=4}
 : ${ARCHS:=${TOOLCHAIN_ARCHS-i686 x86_64 armv7 aarch64 arm64ec}}
 
+MAKE_JOBS="-j$CORES"
+if [ -n "$USE_JOBSERVER" ]; then
+    # Running from build-all.sh --parallel-runtimes; take the jobs from
+    # the jobserver of the parent make instead.
+    MAKE_JOBS=""
+fi
+
 if [ ! -d mingw-w64 ] || [ -n "$SYNC" ]; then
     CHECKOUT_ONLY=1 ./build-mingw-w64.sh
 fi
@@ -55,7 +62,34 @@ if command -v gmake >/dev/null; then
     MAKE=gmake
 fi
 
-cd mingw-w64/mingw-w64-libraries
+cd mingw-w64
+# Use the per-arch caches of configure results that build-mingw-w64.sh
+# shares between the crt and the libraries; see it for details.
+#
+# If changing this, change build-mingw-w64.sh accordingly.
+CACHE_DIR="$(pwd)"
+CACHE_VARS='^(ac_cv_(build|host|objext|c_compiler_gnu|cxx_compiler_gnu|path_|prog_)|am_cv_)'
+
+compiler_id() {
+    $1-w64-mingw32-clang --version
+    cat "$PREFIX/bin/$1-w64-windows-gnu.cfg" "$PREFIX/bin/mingw32-common.cfg" 2>/dev/null
+}
+
+use_config_cache() {
+    CACHE="$CACHE_DIR/config-$1.cache"
+    if [ "$(cat "$CACHE.id" 2>/dev/null)" != "$2" ]; then
+        rm -f "$CACHE"
+        printf '%s\n' "$2" > "$CACHE.id"
+    fi
+    rm -f config.cache
+    [ ! -f "$CACHE" ] || cp "$CACHE" config.cache
+}
+
+save_config_cache() {
+    grep -E "$CACHE_VARS" config.cache > "$CACHE" || true
+}
+
+cd mingw-w64-libraries
 for lib in winpthreads winstorecompat; do
     cd $lib
     for arch in $ARCHS; do
@@ -63,11 +97,16 @@ for lib in winpthreads winstorecompat; do
         mkdir -p build-$arch
         cd build-$arch
         arch_prefix="$PREFIX/$arch-w64-mingw32"
+        use_config_cache $arch "$(compiler_id $arch)"
+        CONFIGURE_START=$(date +%s)
         ../configure --host=$arch-w64-mingw32 --prefix="$arch_prefix" --libdir="$arch_prefix/lib" \
+            --cache-file=config.cache \
             --enable-silent-rules \
             CFLAGS="$USE_CFLAGS" \
             CXXFLAGS="$USE_CFLAGS"
-        $MAKE -j$CORES
+        echo "Configured $lib for $arch in $(($(date +%s) - CONFIGURE_START)) seconds"
+        save_config_cache
+        $MAKE $MAKE_JOBS
         $MAKE install
         cd ..
         mkdir -p "$arch_prefix/share/mingw32"
@@ -27,6 +27,12 @@ while [ $# -gt 0 ]; do
     --skip-include-triplet-prefix)
         SKIP_INCLUDE_TRIPLET_PREFIX=1
         ;;
+    --headers-only)
+        HEADERS_ONLY=1
+        ;;
+    --skip-headers)
+        SKIP_HEADERS=1
+        ;;
     --with-default-win32-winnt=*)
         DEFAULT_WIN32_WINNT="${1#*=}"
         ;;
@@ -47,7 +53,7 @@ while [ $# -gt 0 ]; do
 done
 if [ -z "$CHECKOUT_ONLY" ]; then
     if [ -z "$PREFIX" ]; then
-        echo "$0 [--skip-include-triplet-prefix] [--with-default-win32-winnt=0x601] [--with-default-msvcrt=ucrt] [--enable-cfguard|--disable-cfguard] dest"
+        echo "$0 [--skip-include-triplet-prefix] [--headers-only|--skip-headers] [--with-default-win32-winnt=0x601] [--with-default-msvcrt=ucrt] [--enable-cfguard|--disable-cfguard] dest"
         exit 1
     fi
 
@@ -89,28 +95,113 @@ unset CC
 : ${CORES:=4}
 : ${ARCHS:=${TOOLCHAIN_ARCHS-i686 x86_64 armv7 aarch64 arm64ec}}
 
+MAKE_JOBS="-j$CORES"
+if [ -n "$USE_JOBSERVER" ]; then
+    # Running from build-all.sh --parallel-runtimes; take the jobs from
+    # the jobserver of the parent make instead.
+    MAKE_JOBS=""
+fi
+
+# Keep one cache of configure results per arch in the mingw-w64 checkout,
+# shared by the crt and the libraries (in build-mingw-w64-libraries.sh)
+# and kept across rebuilds. It is discarded when the compiler changes.
+# Each configure starts from a copy of it, and only the results of the
+# compiler and tool checks ($CACHE_VARS) are saved back. Other results
+# may change between configures; link checks start working once the crt
+# is installed, and configure errors out if the precious variables
+# (ac_cv_env_*, e.g. CFLAGS) differ from the cached ones.
+#
+# If changing this, change build-mingw-w64-libraries.sh accordingly.
+CACHE_DIR="$(pwd)"
+CACHE_VARS='^(ac_cv_(build|host|objext|c_compiler_gnu|cxx_compiler_gnu|path_|prog_)|am_cv_)'
+
+compiler_id() {
+    $1-w64-mingw32-clang --version
+    cat "$PREFIX/bin/$1-w64-windows-gnu.cfg" "$PREFIX/bin/mingw32-common.cfg" 2>/dev/null
+}
+
+# Set up config.cache in the current directory from the shared cache named
+# $1, discarding the shared cache first if its identity $2 has changed.
+use_config_cache() {
+    CACHE="$CACHE_DIR/config-$1.cache"
+    if [ "$(cat "$CACHE.id" 2>/dev/null)" != "$2" ]; then
+        rm -f "$CACHE"
+        printf '%s\n' "$2" > "$CACHE.id"
+    fi
+    rm -f config.cache
+    [ ! -f "$CACHE" ] || cp "$CACHE" config.cache
+}
+
+save_config_cache() {
+    grep -E "$CACHE_VARS" config.cache > "$CACHE" || true
+}
+
 if [ -z "$SKIP_INCLUDE_TRIPLET_PREFIX" ]; then
     HEADER_ROOT="$PREFIX/generic-w64-mingw32"
 else
     HEADER_ROOT="$PREFIX"
 fi
 
-cd mingw-w64-headers
-[ -z "$CLEAN" ] || rm -rf build
-mkdir -p build
-cd build
-../configure --prefix="$HEADER_ROOT" \
-    --enable-idl --with-default-win32-winnt=$DEFAULT_WIN32_WINNT --with-default-msvcrt=$DEFAULT_MSVCRT INSTALL="install -C"
-$MAKE install
-cd ../..
-if [ -z "$SKIP_INCLUDE_TRIPLET_PREFIX" ]; then
-    for arch in $ARCHS; do
-        mkdir -p "$PREFIX/$arch-w64-mingw32"
-        if [ ! -e "$PREFIX/$arch-w64-mingw32/include" ]; then
-            ln -sfn ../generic-w64-mingw32/include "$PREFIX/$arch-w64-mingw32/include"
-        fi
-    done
+if [ -z "$SKIP_HEADERS" ]; then
+    cd mingw-w64-headers
+    [ -z "$CLEAN" ] || rm -rf build
+    mkdir -p build
+    cd build
+    # The headers are configured for the build machine rather than for any
+    # of the arches, so they use a cache of their own.
+    use_config_cache headers "$(uname -srm)"
+    ../configure --prefix="$HEADER_ROOT" --cache-file=config.cache \
+        --enable-idl --with-default-win32-winnt=$DEFAULT_WIN32_WINNT --with-default-msvcrt=$DEFAULT_MSVCRT INSTALL="install -C"
+    save_config_cache
+    # Any stat caches from build-stat-cache.sh and precompiled headers from
+    # build-windows-pch.sh would be outdated once the headers are
+    # reinstalled.
+    rm -rf "$PREFIX"/*-w64-mingw32/lib/statcache "$PREFIX"/*-w64-mingw32/lib/pch
+    $MAKE install
+    # Add a module map for windows.h, to allow using it with -fmodules. This
+    # is opt-in, by passing -fmodule-map-file= pointing at it; it isn't
+    # named module.modulemap, as clang then would pick it up implicitly for
+    # anyone using -fmodules, where macros defined in the source before
+    # including windows.h no longer would affect it. The CRT headers it
+    # includes aren't covered by separate modules, as they are also included
+    # (with include_next) from libc++'s modules; they end up as part of
+    # whichever module includes them first. Macros that affect what the
+    # headers declare are listed as configuration macros, so that a
+    # separate module is built for each configuration used.
+    cat > windows.modulemap.new <<EOF
+module windows [system] [extern_c] {
+  config_macros _WIN32_WINNT, WINVER, NTDDI_VERSION, _WIN32_IE, WINAPI_FAMILY,
+                WIN32_LEAN_AND_MEAN, NOMINMAX, STRICT, NOGDI, NOUSER,
+                UNICODE, _UNICODE, _UCRT, __MSVCRT_VERSION__,
+                __USE_MINGW_ANSI_STDIO, _FILE_OFFSET_BITS, _POSIX_C_SOURCE,
+                _GNU_SOURCE, _CRT_SECURE_NO_WARNINGS, _CRT_NONSTDC_NO_DEPRECATE
+  header "windows.h"
+  export *
+}
+EOF
+    # Only replace the file if it changed, like the headers are installed
+    # with "install -C", to avoid invalidating existing module caches.
+    if cmp -s windows.modulemap.new "$HEADER_ROOT/include/windows.modulemap"; then
+        rm windows.modulemap.new
+    else
+        mv windows.modulemap.new "$HEADER_ROOT/include/windows.modulemap"
+    fi
+    # Remove the implicitly used module map installed by earlier versions
+    # of this script.
+    if grep -q "^module windows " "$HEADER_ROOT/include/module.modulemap" 2>/dev/null; then
+        rm -f "$HEADER_ROOT/include/module.modulemap"
+    fi
+    cd ../..
+    if [ -z "$SKIP_INCLUDE_TRIPLET_PREFIX" ]; then
+        for arch in $ARCHS; do
+            mkdir -p "$PREFIX/$arch-w64-mingw32"
+            if [ ! -e "$PREFIX/$arch-w64-mingw32/include" ]; then
+                ln -sfn ../generic-w64-mingw32/include "$PREFIX/$arch-w64-mingw32/include"
+            fi
+        done
+    fi
 fi
+[ -z "$HEADERS_ONLY" ] || exit 0
 
 cd mingw-w64-crt
 for arch in $ARCHS; do
@@ -133,8 +224,12 @@ for arch in $ARCHS; do
     esac
     FLAGS="$FLAGS --with-default-msvcrt=$DEFAULT_MSVCRT"
     FLAGS="$FLAGS --enable-silent-rules"
-    ../configure --host=$arch-w64-mingw32 --prefix="$PREFIX/$arch-w64-mingw32" $FLAGS $CFGUARD_FLAGS $CRT_CONFIG_FLAGS
-    $MAKE -j$CORES
+    use_config_cache $arch "$(compiler_id $arch)"
+    CONFIGURE_START=$(date +%s)
+    ../configure --host=$arch-w64-mingw32 --prefix="$PREFIX/$arch-w64-mingw32" --cache-file=config.cache $FLAGS $CFGUARD_FLAGS $CRT_CONFIG_FLAGS
+    echo "Configured mingw-w64-crt for $arch in $(($(date +%s) - CONFIGURE_START)) seconds"
+    save_config_cache
+    $MAKE $MAKE_JOBS
     $MAKE install
     cd ..
 done
@@ -148,6 +243,15 @@ for arch in $ARCHS; do
         llvm-ar rcs $PREFIX/$arch-w64-mingw32/lib/libssp_nonshared.a
     fi
 
+    # Check that windows.h can be built as a module with the module map
+    # installed above. This is an optional feature, so only warn if it
+    # fails.
+    MODULE_CACHE="$(mktemp -d)"
+    if ! echo "#include <windows.h>" | $arch-w64-mingw32-clang -x c -fsyntax-only -fmodules -fmodules-cache-path="$MODULE_CACHE" -fmodule-map-file="$HEADER_ROOT/include/windows.modulemap" -; then
+        echo "warning: Building windows.h as a module failed for $arch" >&2
+    fi
+    rm -rf "$MODULE_CACHE"
+
     mkdir -p "$PREFIX/$arch-w64-mingw32/share/mingw32"
     for file in COPYING COPYING.MinGW-w64/COPYING.MinGW-w64.txt COPYING.MinGW-w64-runtime/COPYING.MinGW-w64-runtime.txt; do
         install -m644 "$file" "$PREFIX/$arch-w64-mingw32/share/mingw32"
@@ -63,6 +63,11 @@ else
         ;;
     esac
 fi
+if [ -n "$USE_JOBSERVER" ]; then
+    # Running from build-all.sh --parallel-runtimes; let the build tool
+    # take the jobs from the jobserver of the parent make instead.
+    unset CORES
+fi
 
 for arch in $ARCHS; do
     CMAKEFLAGS=""
@@ -95,6 +100,9 @@ for arch in $ARCHS; do
         $CMAKEFLAGS \
         ..
     cmake --build . ${CORES:+-j${CORES}}
+    # Any stat caches from build-stat-cache.sh would be outdated once the
+    # headers are reinstalled.
+    rm -rf "$PREFIX/$arch-w64-mingw32/lib/statcache"
     cmake --install .
     rm -f $PREFIX/$arch-w64-mingw32/bin/*iomp5md*
     rm -f $PREFIX/$arch-w64-mingw32/lib/*iomp5md*
@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 Martin Storsjo
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Generate stat caches for the header directories of the toolchain, which
+# clang can use (with -ivfsstatcache, which the wrappers pass when
+# LLVM_MINGW_STAT_CACHE=1 is set) instead of doing a syscall for each
+# probed path in the include directories. This requires the
+# clang-stat-cache tool; if it isn't available, nothing is done.
+#
+# The caches must be regenerated whenever the headers are changed. The
+# scripts that install headers remove the outdated caches, and build-all.sh
+# runs this script afterwards. The caches contain absolute paths; the
+# wrappers only use them if the toolchain still is located where they
+# were generated.
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo $0 dest
+    exit 1
+fi
+PREFIX="$1"
+# Use the physical path, as the wrappers pass clang paths with any
+# symlinks resolved.
+PREFIX="$(cd "$PREFIX" && pwd -P)"
+export PATH=$PREFIX/bin:$PATH
+
+if ! command -v clang-stat-cache >/dev/null; then
+    echo "clang-stat-cache not available, not generating stat caches"
+    exit 0
+fi
+
+: ${ARCHS:=${TOOLCHAIN_ARCHS-i686 x86_64 armv7 aarch64 arm64ec}}
+
+RESOURCE_DIR="$("$PREFIX/bin/clang" -print-resource-dir)"
+for arch in $ARCHS; do
+    # The cached paths must match the paths that clang looks up, so use
+    # the $arch-w64-mingw32/include path (which is a symlink to the
+    # generic include directory) rather than the generic one. The wrappers
+    # look for these specific file names.
+    CACHE_DIR="$PREFIX/$arch-w64-mingw32/lib/statcache"
+    rm -rf "$CACHE_DIR"
+    mkdir -p "$CACHE_DIR"
+    clang-stat-cache "$PREFIX/$arch-w64-mingw32/include" -o "$CACHE_DIR/include.statcache"
+    clang-stat-cache "$RESOURCE_DIR/include" -o "$CACHE_DIR/resource-include.statcache"
+    # Record where the toolchain was located, for the wrappers to check.
+    echo "$PREFIX" > "$CACHE_DIR/root"
+done
@@ -0,0 +1,104 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 Martin Storsjo
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Precompile windows.h for each architecture, for a number of common
+# configurations. The wrappers use these for compiling, when
+# LLVM_MINGW_WINDOWS_PCH=1 is set in the environment. Clang checks that the
+# language, target and code generation options of a compilation match the
+# ones a precompiled header was built with; the wrappers compile without
+# the precompiled header if clang rejects it.
+#
+# The precompiled header is implicitly included before the source file;
+# the wrappers only do this for source files whose first directive is an
+# include of windows.h, so that no macros defined in the source file
+# itself can affect it. Clang doesn't check whether macros defined, or
+# include directories added, on the command line would have affected the
+# header; for the wrappers to check that, this also lists the headers that
+# windows.h includes and all identifiers that appear in them.
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo $0 dest
+    exit 1
+fi
+PREFIX="$1"
+PREFIX="$(cd "$PREFIX" && pwd)"
+export PATH=$PREFIX/bin:$PATH
+
+: ${ARCHS:=${TOOLCHAIN_ARCHS-i686 x86_64 armv7 aarch64 arm64ec}}
+# Values of _WIN32_WINNT to build headers for, in addition to the default
+# value (without _WIN32_WINNT set on the command line).
+: ${WINDOWS_PCH_WINNT:=}
+
+for arch in $ARCHS; do
+    PCH_DIR="$PREFIX/$arch-w64-mingw32/lib/pch"
+    rm -rf "$PCH_DIR"
+    mkdir -p "$PCH_DIR"
+    echo "#include <windows.h>" > "$PCH_DIR/windows-pch.h"
+    for lang in c c++; do
+        case $lang in
+        c)
+            CC=$arch-w64-mingw32-clang
+            ;;
+        c++)
+            CC=$arch-w64-mingw32-clang++
+            ;;
+        esac
+        # The file names here must match what the wrappers look for.
+        # List the headers relative to the include directory they were
+        # found in, as that is how they would be found in an include
+        # directory given on the command line. Identifiers within comments
+        # are included too, which is harmless.
+        $CC -x $lang-header -fsyntax-only -H "$PCH_DIR/windows-pch.h" 2>&1 >/dev/null | \
+            sed -n 's/^\.* //p' | sort -u > "$PCH_DIR/windows-$lang.files"
+        sed 's,.*[/\\]include[/\\],,' "$PCH_DIR/windows-$lang.files" | LC_ALL=C sort -u > "$PCH_DIR/windows-$lang.headers"
+        while IFS= read -r file; do
+            cat "$file"
+        done < "$PCH_DIR/windows-$lang.files" | \
+            grep -o '[A-Za-z_][A-Za-z0-9_]*' | LC_ALL=C sort -u > "$PCH_DIR/windows-$lang.idents"
+        rm "$PCH_DIR/windows-$lang.files"
+        for opt in "" 1; do
+            for winnt in "" $WINDOWS_PCH_WINNT; do
+                for lean in "" 1; do
+                    for unicode in "" 1; do
+                        NAME=windows-$lang
+                        FLAGS="-O0"
+                        if [ -n "$opt" ]; then
+                            # Any optimization level but -Os/-Oz gives the
+                            # same language options as -O2.
+                            NAME=$NAME-opt
+                            FLAGS="-O2"
+                        fi
+                        if [ -n "$winnt" ]; then
+                            NAME=$NAME-$winnt
+                            FLAGS="$FLAGS -D_WIN32_WINNT=$winnt"
+                        fi
+                        if [ -n "$lean" ]; then
+                            NAME=$NAME-lean
+                            FLAGS="$FLAGS -DWIN32_LEAN_AND_MEAN"
+                        fi
+                        if [ -n "$unicode" ]; then
+                            NAME=$NAME-unicode
+                            FLAGS="$FLAGS -DUNICODE -D_UNICODE"
+                        fi
+                        $CC -x $lang-header $FLAGS -Xclang -fmodules-embed-all-files "$PCH_DIR/windows-pch.h" -o "$PCH_DIR/$NAME.pch"
+                    done
+                done
+            done
+        done
+    done
+done
@@ -139,23 +139,24 @@ fi
 $CC wrappers/clang-target-wrapper.c -o "$PREFIX/bin/clang-target-wrapper$EXEEXT" -O2 -Wl,-s $WRAPPER_FLAGS
 $CC wrappers/clang-scan-deps-wrapper.c -o "$PREFIX/bin/clang-scan-deps-wrapper$EXEEXT" -O2 -Wl,-s $WRAPPER_FLAGS
 $CC wrappers/llvm-wrapper.c -o "$PREFIX/bin/llvm-wrapper$EXEEXT" -O2 -Wl,-s $WRAPPER_FLAGS
+$CC wrappers/ld-wrapper.c -o "$PREFIX/bin/ld-wrapper$EXEEXT" -O2 -Wl,-s $WRAPPER_FLAGS
+$CC wrappers/objdump-wrapper.c -o "$PREFIX/bin/objdump-wrapper$EXEEXT" -O2 -Wl,-s $WRAPPER_FLAGS
+$CC wrappers/thinlto-local-distributor.c -o "$PREFIX/bin/thinlto-local-distributor$EXEEXT" -O2 -Wl,-s $WRAPPER_FLAGS
+# Prefer the executable wrappers over the shell script ones; on Windows,
+# they also work when invoked from outside of MSYS, and on other hosts,
+# they avoid the overhead of starting a shell for each invocation.
 if [ -n "$EXEEXT" ]; then
-    # For Windows, we should prefer the executable wrapper, which also works
-    # when invoked from outside of MSYS.
-    CTW_SUFFIX=$EXEEXT
-    CTW_LINK_SUFFIX=$EXEEXT
     CSDW=clang-scan-deps-wrapper$EXEEXT
 else
-    CTW_SUFFIX=.sh
     CSDW=clang-scan-deps
 fi
 cd "$PREFIX/bin"
 for arch in $ARCHS; do
     for target_os in $TARGET_OSES; do
         for exec in clang clang++ gcc g++ c++ as; do
-            ln -sf clang-target-wrapper$CTW_SUFFIX $arch-w64-$target_os-$exec$CTW_LINK_SUFFIX
+            ln -sf clang-target-wrapper$EXEEXT $arch-w64-$target_os-$exec$EXEEXT
         done
-        ln -sf $CSDW $arch-w64-$target_os-clang-scan-deps$CTW_LINK_SUFFIX
+        ln -sf $CSDW $arch-w64-$target_os-clang-scan-deps$EXEEXT
         for exec in addr2line ar ranlib nm objcopy readelf size strings strip llvm-ar llvm-ranlib; do
             if [ -n "$EXEEXT" ]; then
                 link_target=llvm-wrapper
@@ -176,7 +177,7 @@ for arch in $ARCHS; do
         ln -sf llvm-windres$EXEEXT $arch-w64-$target_os-windres$EXEEXT
         ln -sf llvm-dlltool$EXEEXT $arch-w64-$target_os-dlltool$EXEEXT
         for exec in ld objdump; do
-            ln -sf $exec-wrapper.sh $arch-w64-$target_os-$exec
+            ln -sf $exec-wrapper$EXEEXT $arch-w64-$target_os-$exec$EXEEXT
         done
     done
 done
@@ -195,15 +196,12 @@ if [ -n "$EXEEXT" ]; then
     # we are installing wrappers for.
     case $ARCHS in
     *$HOST_ARCH*)
-        for exec in clang clang++ gcc g++ c++ addr2line ar dlltool ranlib nm objcopy readelf size strings strip windres clang-scan-deps; do
+        for exec in clang clang++ gcc g++ c++ addr2line ar dlltool ld objdump ranlib nm objcopy readelf size strings strip windres clang-scan-deps; do
             ln -sf $HOST-$exec$EXEEXT $exec$EXEEXT
         done
         for exec in cc c99 c11; do
             ln -sf clang$EXEEXT $exec$EXEEXT
         done
-        for exec in ld objdump; do
-            ln -sf $HOST-$exec $exec
-        done
         ;;
     esac
 fi
@@ -23,20 +23,25 @@ fi
 
 TAG=$1
 
+# Record how long each image takes to build; see timeline-report.sh.
+export BUILD_TIMELINE="$(pwd)/release-timeline-$TAG.log"
+rm -f "$BUILD_TIMELINE"
+
 if [ "$2" = "nativeonly" ]; then
     NATIVEONLY=1
 fi
 
-time docker build -f Dockerfile . -t mstorsjo/llvm-mingw:latest -t mstorsjo/llvm-mingw:$TAG
+time ./timeline.sh llvm-mingw docker build -f Dockerfile . -t mstorsjo/llvm-mingw:latest -t mstorsjo/llvm-mingw:$TAG
 
 DISTRO=ubuntu-24.04-$(uname -m)
 docker run --rm mstorsjo/llvm-mingw:latest sh -c "cd /opt && mv llvm-mingw llvm-mingw-$TAG-ucrt-$DISTRO && tar -Jcvf - --format=ustar --numeric-owner --owner=0 --group=0 llvm-mingw-$TAG-ucrt-$DISTRO" > llvm-mingw-$TAG-ucrt-$DISTRO.tar.xz
 
 if [ -n "$NATIVEONLY" ]; then
+    ./timeline-report.sh "$BUILD_TIMELINE"
     exit 0
 fi
 
-time docker build -f Dockerfile.dev . -t mstorsjo/llvm-mingw:dev -t mstorsjo/llvm-mingw:dev-$TAG
+time ./timeline.sh llvm-mingw-dev docker build -f Dockerfile.dev . -t mstorsjo/llvm-mingw:dev -t mstorsjo/llvm-mingw:dev-$TAG
 
 cleanup() {
     for i in $temp_images; do
@@ -49,19 +54,21 @@ trap cleanup EXIT INT TERM
 for arch in i686 x86_64 armv7 aarch64; do
     temp=$(uuidgen)
     temp_images="$temp_images $temp"
-    time docker build -f Dockerfile.cross --build-arg BASE=mstorsjo/llvm-mingw:dev --build-arg CROSS_ARCH=$arch --build-arg TAG=$TAG-ucrt- --build-arg WITH_PYTHON=1 --build-arg WITH_BUSYBOX=1 -t $temp .
+    time ./timeline.sh cross-ucrt-$arch docker build -f Dockerfile.cross --build-arg BASE=mstorsjo/llvm-mingw:dev --build-arg CROSS_ARCH=$arch --build-arg TAG=$TAG-ucrt- --build-arg WITH_PYTHON=1 --build-arg WITH_BUSYBOX=1 -t $temp .
     ./extract-docker.sh $temp /llvm-mingw-$TAG-ucrt-$arch.zip
 done
 
 msvcrt_image=llvm-mingw-msvcrt-$(uuidgen)
 temp_images="$temp_images $msvcrt_image"
-time docker build -f Dockerfile.dev -t $msvcrt_image --build-arg DEFAULT_CRT=msvcrt .
+time ./timeline.sh llvm-mingw-dev-msvcrt docker build -f Dockerfile.dev -t $msvcrt_image --build-arg DEFAULT_CRT=msvcrt .
 
 docker run --rm $msvcrt_image sh -c "cd /opt && mv llvm-mingw llvm-mingw-$TAG-msvcrt-$DISTRO && tar -Jcvf - --format=ustar --numeric-owner --owner=0 --group=0 llvm-mingw-$TAG-msvcrt-$DISTRO" > llvm-mingw-$TAG-msvcrt-$DISTRO.tar.xz
 
 for arch in i686 x86_64; do
     temp=$(uuidgen)
     temp_images="$temp_images $temp"
-    time docker build -f Dockerfile.cross --build-arg BASE=$msvcrt_image --build-arg CROSS_ARCH=$arch --build-arg TAG=$TAG-msvcrt- --build-arg WITH_PYTHON=1 -t $temp .
+    time ./timeline.sh cross-msvcrt-$arch docker build -f Dockerfile.cross --build-arg BASE=$msvcrt_image --build-arg CROSS_ARCH=$arch --build-arg TAG=$TAG-msvcrt- --build-arg WITH_PYTHON=1 -t $temp .
     ./extract-docker.sh $temp /llvm-mingw-$TAG-msvcrt-$arch.zip
 done
+
+./timeline-report.sh "$BUILD_TIMELINE"
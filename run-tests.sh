@@ -29,6 +29,13 @@ export PATH=$PREFIX/bin:$PATH
 : ${CORES:=4}
 : ${ARCHS:=${TOOLCHAIN_ARCHS-i686 x86_64 armv7 aarch64 arm64ec}}
 
+# If collecting time traces, the make invocations below run in different
+# directories; use an absolute path for them.
+if [ -n "$LLVM_MINGW_TIME_TRACE" ]; then
+    mkdir -p "$LLVM_MINGW_TIME_TRACE"
+    export LLVM_MINGW_TIME_TRACE="$(cd "$LLVM_MINGW_TIME_TRACE" && pwd)"
+fi
+
 MAKE=make
 if command -v gmake >/dev/null; then
     MAKE=gmake
@@ -264,5 +271,36 @@ for arch in $ARCHS; do
     $MAKE -f ../Makefile ARCH=$arch HAVE_UWP=$HAVE_UWP HAVE_CFGUARD=$HAVE_CFGUARD HAVE_ASAN=$HAVE_ASAN HAVE_UBSAN=$HAVE_UBSAN HAVE_OPENMP=$HAVE_OPENMP NATIVE=$NATIVE RUNTIMES_SRC=$PREFIX/$arch-w64-mingw32/bin clean
     $MAKE -f ../Makefile ARCH=$arch HAVE_UWP=$HAVE_UWP HAVE_CFGUARD=$HAVE_CFGUARD HAVE_ASAN=$HAVE_ASAN HAVE_UBSAN=$HAVE_UBSAN HAVE_OPENMP=$HAVE_OPENMP NATIVE=$NATIVE RUNTIMES_SRC=$PREFIX/$arch-w64-mingw32/bin RUN="$RUN" $COPYARG $MAKEOPTS -j$CORES $TARGET
     cd ..
+
+    # Check that objects built with LLVM_MINGW_BASEDIR set don't depend on
+    # the location of the source.
+    for dir in repro-a repro-b; do
+        rm -rf $TEST_DIR/$dir
+        mkdir -p $TEST_DIR/$dir
+        cp hello.c hello-cpp.cpp tlstest-main.cpp $TEST_DIR/$dir
+        (
+            cd $TEST_DIR/$dir
+            # Within WSL, the Windows tools can't use the absolute paths,
+            # and only get the environment variables listed in WSLENV
+            # (where /p translates the path to a Windows one).
+            SRC_DIR=.
+            if [ -n "$WSL" ]; then
+                export WSLENV="${WSLENV:+$WSLENV:}LLVM_MINGW_BASEDIR/p"
+            else
+                SRC_DIR="$(pwd)"
+            fi
+            export LLVM_MINGW_BASEDIR="$(pwd)"
+            $arch-w64-mingw32-clang$TOOLEXT -g -c "$SRC_DIR/hello.c" -o hello.o
+            $arch-w64-mingw32-clang++$TOOLEXT -g -c "$SRC_DIR/hello-cpp.cpp" -o hello-cpp.o
+            $arch-w64-mingw32-clang++$TOOLEXT -g -c tlstest-main.cpp -o tlstest-main.o
+        )
+    done
+    for obj in hello.o hello-cpp.o tlstest-main.o; do
+        cmp $TEST_DIR/repro-a/$obj $TEST_DIR/repro-b/$obj
+    done
+    rm -rf $TEST_DIR/repro-a $TEST_DIR/repro-b
 done
+if [ -n "$LLVM_MINGW_TIME_TRACE" ]; then
+    ../time-trace-report.sh "$LLVM_MINGW_TIME_TRACE"
+fi
 echo All tests succeeded
@@ -74,7 +74,7 @@ for i in amdgpu-arch bugpoint c-index-test clang-* clangd clangd-* darwin-debug
         ;;
     clangd)
         ;;
-    clang-scan-deps)
+    clang-scan-deps|clang-stat-cache)
         ;;
     clang-tidy)
         ;;
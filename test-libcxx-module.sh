@@ -37,6 +37,13 @@ for arch in $ARCHS; do
     # TODO: This should ideally use "$CXX -print-file-name=libc++.modules.json", then parse the json to find the relevant cppm file and include directory.
     $arch-w64-mingw32-clang++ -I$PREFIX/share/libc++/v1 -std=gnu++23 -Wno-reserved-module-identifier -x c++-module -fmodule-output=std.pcm -o std.cppm.obj -c $PREFIX/share/libc++/v1/std.cppm
     $arch-w64-mingw32-clang++ -I$PREFIX/share/libc++/v1 -std=gnu++23 -Wno-reserved-module-identifier -x c++-module -fmodule-output=std.compat.pcm -fmodule-file=std=std.pcm -o std.compat.cppm.obj -c $PREFIX/share/libc++/v1/std.compat.cppm
+    # Test the std module prebuilt by build-libcxx.sh.
+    $arch-w64-mingw32-clang++ -std=c++23 test/import-std.cpp -o import-std-$arch.exe
+    $arch-w64-mingw32-clang++ -std=gnu++23 test/import-std.cpp -o import-std-gnu-$arch.exe
+    # Test using windows.h and libc++ as implicit modules.
+    WINDOWS_MODULEMAP=$PREFIX/$arch-w64-mingw32/include/windows.modulemap
+    $arch-w64-mingw32-clang -fmodules -fmodules-cache-path=module-cache -fmodule-map-file=$WINDOWS_MODULEMAP -c test/hello-tls.c -o hello-tls-modules-$arch.o
+    $arch-w64-mingw32-clang++ -fmodules -fmodules-cache-path=module-cache -fmodule-map-file=$WINDOWS_MODULEMAP -c test/tlstest-main.cpp -o tlstest-main-modules-$arch.o
     $arch-w64-mingw32-clang-scan-deps -format=p1689 -- $arch-w64-mingw32-clang++ -std=c++23 -c test/test-scan-deps.cpp -DEXPECT_$arch
 done
 
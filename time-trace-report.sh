@@ -0,0 +1,112 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 Martin Storsjo
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Summarize the time traces written by the wrappers when LLVM_MINGW_TIME_TRACE
+# is set, e.g.
+#
+#   LLVM_MINGW_TIME_TRACE=$(pwd)/time-trace make -j$(nproc)
+#   ./time-trace-report.sh time-trace
+#
+# Prints the total compile time per architecture, and the headers, template
+# instantiations and functions that took the most time to process, summed
+# over all compilations. The time for a header includes the time for the
+# headers it includes in turn.
+
+set -e
+
+TOP=10
+while [ $# -gt 0 ]; do
+    case "$1" in
+    --top=*)
+        TOP="${1#*=}"
+        ;;
+    *)
+        DIR="$1"
+        ;;
+    esac
+    shift
+done
+if [ -z "$DIR" ]; then
+    echo $0 dir [--top=N]
+    exit 1
+fi
+
+# Clang writes the trace on a single line; split it into one event per
+# line, and print the events we're interested in, with the architecture
+# taken from the name of the directory the trace is in. The categories are
+# numbered in the order they are printed, with 0 for the total time.
+find "$DIR" -name '*.json' -exec awk '
+function str(event, key) {
+    if (!match(event, "\"" key "\":\"([^\"\\\\]|\\\\.)*\""))
+        return ""
+    return substr(event, RSTART + length(key) + 4, RLENGTH - length(key) - 5)
+}
+function num(event, key) {
+    if (!match(event, "\"" key "\":[0-9]+"))
+        return 0
+    return substr(event, RSTART + length(key) + 3, RLENGTH - length(key) - 3) + 0
+}
+{
+    arch = FILENAME
+    sub(/\/[^\/]*$/, "", arch)
+    sub(/.*\//, "", arch)
+    n = split($0, events, /\},[ \t]*\{/)
+    for (i = 1; i <= n; i++) {
+        name = str(events[i], "name")
+        if (name == "ExecuteCompiler")
+            category = 0
+        else if (name == "Source")
+            category = 1
+        else if (name == "InstantiateClass" || name == "InstantiateFunction")
+            category = 2
+        else if (name == "CodeGen Function" || name == "OptFunction")
+            category = 3
+        else
+            continue
+        printf "%s\t%s\t%d\t%s\n", arch, category, num(events[i], "dur"), str(events[i], "detail")
+    }
+}' {} + | awk -F '\t' '
+{
+    key = $1 "\t" $2 "\t" $4
+    total[key] += $3
+    count[key]++
+}
+END {
+    for (key in total)
+        printf "%s\t%d\t%d\n", key, total[key], count[key]
+}' | sort -t "$(printf '\t')" -k1,1 -k2,2n -k4,4nr | awk -F '\t' -v top="$TOP" '
+BEGIN {
+    split("headers templates functions", categories, " ")
+}
+$1 != arch {
+    arch = $1
+    category = ""
+    printf "%s%s\n", sep, arch
+    sep = "\n"
+}
+$2 == 0 {
+    printf "  %d compilations, %.2f s total\n", $5, $4 / 1e6
+    next
+}
+$2 != category {
+    category = $2
+    shown = 0
+    printf "\n  %-10s %8s %10s  %s\n", categories[category], "count", "time (ms)", "name"
+}
+shown < top {
+    shown++
+    printf "  %-10s %8d %10.1f  %s\n", "", $5, $4 / 1e3, $3
+}'
@@ -0,0 +1,193 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 Martin Storsjo
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Summarize a build timeline recorded with BUILD_TIMELINE set, e.g.
+#
+#   BUILD_TIMELINE=$(pwd)/timeline.log ./build-all.sh <dest>
+#   ./timeline-report.sh timeline.log .
+#
+# Prints all recorded steps in the order they started, with a bar showing
+# when they ran, and the critical path through them: the chain of steps,
+# each one ending before the next one started, that ends with the step
+# that finished last.
+#
+# If a source directory is given (e.g. the directory build-all.sh was run
+# in), then for each CMake build directory using ninja below it, the time
+# taken by the latest build in it and its slowest translation units are
+# printed too, from its .ninja_log.
+
+set -e
+
+TOP=5
+while [ $# -gt 0 ]; do
+    case "$1" in
+    --top=*)
+        TOP="${1#*=}"
+        ;;
+    *)
+        if [ -z "$TIMELINE" ]; then
+            TIMELINE="$1"
+        else
+            SRC="$1"
+        fi
+        ;;
+    esac
+    shift
+done
+if [ -z "$TIMELINE" ]; then
+    echo $0 timeline [srcdir] [--top=N]
+    exit 1
+fi
+
+awk -F '\t' '
+BEGIN {
+    n = 0
+}
+{
+    name[n] = $1
+    start[n] = $2
+    end[n] = $3
+    status[n] = $4
+    if (n == 0 || $2 < first)
+        first = $2
+    if (n == 0 || $3 > last)
+        last = $3
+    n++
+}
+function bar(s, e,    width, from, to, str, i) {
+    width = 40
+    from = int((s - first) * width / span)
+    to = int((e - first) * width / span)
+    if (from >= width)
+        from = width - 1
+    if (to <= from)
+        to = from + 1
+    str = ""
+    for (i = 0; i < width; i++)
+        str = str (i >= from && i < to ? "#" : ".")
+    return str
+}
+function hms(t) {
+    return sprintf("%d:%02d:%02d", t / 3600, (t / 60) % 60, t % 60)
+}
+END {
+    if (n == 0)
+        exit
+    span = last - first
+    if (span == 0)
+        span = 1
+
+    # Print the steps sorted by start time.
+    for (i = 0; i < n; i++)
+        order[i] = i
+    for (i = 1; i < n; i++) {
+        for (j = i; j > 0; j--) {
+            a = order[j - 1]
+            b = order[j]
+            if (start[a] < start[b] || (start[a] == start[b] && end[a] >= end[b]))
+                break
+            order[j - 1] = b
+            order[j] = a
+        }
+    }
+    printf "%-36s %9s %9s  %s\n", "step", "start", "duration", "timeline"
+    for (i = 0; i < n; i++) {
+        k = order[i]
+        printf "%-36s %9s %9s  %s%s\n", name[k], hms(start[k] - first), hms(end[k] - start[k]), bar(start[k], end[k]), status[k] != 0 ? " (failed)" : ""
+    }
+    printf "total: %s\n", hms(span)
+
+    # Walk backwards from the step that ended last, each time picking the
+    # step that ended last before the current one started. The steps are
+    # recorded as they end, so only earlier records need to be considered,
+    # and for steps ending at the same time, the later record is picked.
+    cur = -1
+    for (i = 0; i < n; i++)
+        if (cur < 0 || end[i] >= end[cur])
+            cur = i
+    count = 0
+    while (cur >= 0) {
+        path[count++] = cur
+        prev = -1
+        for (i = 0; i < cur; i++)
+            if (end[i] <= start[cur] && (prev < 0 || end[i] >= end[prev]))
+                prev = i
+        cur = prev
+    }
+    printf "\ncritical path:\n"
+    printf "%-36s %9s %9s %9s\n", "step", "start", "duration", "idle"
+    prev_end = first
+    for (i = count - 1; i >= 0; i--) {
+        k = path[i]
+        printf "%-36s %9s %9s %9s\n", name[k], hms(start[k] - first), hms(end[k] - start[k]), hms(start[k] - prev_end)
+        prev_end = end[k]
+    }
+}' "$TIMELINE"
+
+# The .ninja_log files have one line per output built, with the start and
+# end time in milliseconds, relative to the start of that ninja invocation.
+# Only look at the last invocation, starting after the last time the end
+# times go backwards.
+if [ -z "$SRC" ]; then
+    exit 0
+fi
+for log in $(find "$SRC" -maxdepth 4 -name .ninja_log | sort); do
+    awk -F '\t' -v dir="${log%/.ninja_log}" -v top="$TOP" '
+    BEGIN {
+        n = 0
+    }
+    /^#/ {
+        next
+    }
+    {
+        if ($2 < prev_end)
+            n = 0
+        prev_end = $2
+        # Outputs of the same edge have identical lines, except for the
+        # output name.
+        key = $1 "\t" $2 "\t" $5
+        if (n > 0 && key == prev_key)
+            next
+        prev_key = key
+        start[n] = $1
+        end[n] = $2
+        output[n] = $4
+        n++
+    }
+    END {
+        if (n == 0)
+            exit
+        first = start[0]
+        total = 0
+        for (i = 0; i < n; i++) {
+            if (start[i] < first)
+                first = start[i]
+            total += end[i] - start[i]
+        }
+        printf "\n%s: %d steps, %.1f s wall, %.1f s cpu\n", dir, n, (end[n - 1] - first) / 1000, total / 1000
+        # Pick the slowest translation units.
+        for (t = 0; t < top; t++) {
+            best = -1
+            for (i = 0; i < n; i++)
+                if (!(i in shown) && output[i] ~ /\.(o|obj)$/ && (best < 0 || end[i] - start[i] > end[best] - start[best]))
+                    best = i
+            if (best < 0)
+                break
+            shown[best] = 1
+            printf "  %8.1f s  %s\n", (end[best] - start[best]) / 1000, output[best]
+        }
+    }' "$log"
+done
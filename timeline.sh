@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 Martin Storsjo
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Run a build step, and if BUILD_TIMELINE is set, append a record of when
+# it started and ended to that file, for timeline-report.sh, e.g.
+#
+#   BUILD_TIMELINE=$(pwd)/timeline.log ./timeline.sh llvm ./build-llvm.sh ...
+#
+# Each record is one line with the name of the step, its start and end
+# time (in seconds since the epoch) and its exit status, separated by tabs.
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo $0 name command [args]
+    exit 1
+fi
+NAME="$1"
+shift
+
+if [ -z "$BUILD_TIMELINE" ]; then
+    exec "$@"
+fi
+
+START=$(date +%s)
+STATUS=0
+"$@" || STATUS=$?
+printf '%s\t%s\t%s\t%s\n' "$NAME" $START $(date +%s) $STATUS >> "$BUILD_TIMELINE"
+exit $STATUS
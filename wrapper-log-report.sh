@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 Martin Storsjo
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Summarize a log written by the wrappers when LLVM_MINGW_LOG is set, e.g.
+#
+#   LLVM_MINGW_LOG=$(pwd)/build.log make -j$(nproc)
+#   ./wrapper-log-report.sh build.log build-trace.json
+#
+# Prints the number of invocations, the total wall and cpu time, and the
+# largest peak memory usage, per target and tool. If a second argument is
+# given, a trace in the Chrome trace event format is written there too,
+# which can be loaded in chrome://tracing or https://ui.perfetto.dev.
+#
+# Only tools invoked through the executable wrappers are logged; e.g.
+# windres and dlltool are plain symlinks to the llvm tools, and the llvm
+# binutils replacements are too, on non-Windows hosts.
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo $0 log [trace.json]
+    exit 1
+fi
+LOG="$1"
+TRACE="$2"
+
+AWK_FIELDS='
+function num(key) {
+    if (!match($0, "\"" key "\":[0-9]+"))
+        return 0
+    return substr($0, RSTART + length(key) + 3, RLENGTH - length(key) - 3) + 0
+}
+function str(key) {
+    if (!match($0, "\"" key "\":\"[^\"]*\""))
+        return ""
+    return substr($0, RSTART + length(key) + 4, RLENGTH - length(key) - 5)
+}
+'
+
+awk "$AWK_FIELDS"'
+{
+    key = str("target") " " str("exe")
+    if (!(key in count))
+        keys[n++] = key
+    count[key]++
+    wall[key] += num("dur")
+    user[key] += num("user")
+    sys[key] += num("sys")
+    if (num("maxrss") > rss[key])
+        rss[key] = num("maxrss")
+    if (num("exit") != 0)
+        failed[key]++
+}
+END {
+    printf "%-28s %-10s %8s %12s %12s %12s %10s %7s\n", "target", "exe", "count", "wall (s)", "user (s)", "sys (s)", "rss (MB)", "failed"
+    for (i = 0; i < n; i++) {
+        split(keys[i], parts, " ")
+        printf "%-28s %-10s %8d %12.2f %12.2f %12.2f %10.1f %7d\n", parts[1], parts[2], count[keys[i]], wall[keys[i]] / 1e6, user[keys[i]] / 1e6, sys[keys[i]] / 1e6, rss[keys[i]] / 1048576, failed[keys[i]]
+        total_wall += wall[keys[i]]
+        total_cpu += user[keys[i]] + sys[keys[i]]
+    }
+    printf "total: %.2f s wall, %.2f s cpu\n", total_wall / 1e6, total_cpu / 1e6
+}' "$LOG"
+
+if [ -n "$TRACE" ]; then
+    awk "$AWK_FIELDS"'
+    BEGIN {
+        printf "{\"traceEvents\":[\n"
+    }
+    {
+        printf "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.0f,\"pid\":1,\"tid\":%.0f,\"args\":{\"argc\":%.0f,\"user\":%.0f,\"sys\":%.0f,\"maxrss\":%.0f,\"exit\":%.0f}}", sep, str("tool"), str("arch"), num("ts"), num("dur"), num("pid"), num("argc"), num("user"), num("sys"), num("maxrss"), num("exit")
+        sep = ",\n"
+    }
+    END {
+        printf "\n],\"displayTimeUnit\":\"ms\"}\n"
+    }' "$LOG" > "$TRACE"
+fi
@@ -25,6 +25,127 @@
 #define DEFAULT_TARGET "x86_64-w64-mingw32"
 #endif
 
+#ifdef _WIN32
+// Check whether a compiler command, as found in a compilation database,
+// is a <triple>-<exe> style command.
+static int cmd_has_target(const char *cmd, size_t len) {
+    const char *start = cmd;
+    for (size_t i = 0; i < len; i++) {
+        if (cmd[i] == '/' || cmd[i] == '\\')
+            start = cmd + i + 1;
+    }
+    TCHAR name[256];
+    size_t name_len = cmd + len - start;
+    if (name_len >= sizeof(name)/sizeof(name[0]))
+        return 0;
+    for (size_t i = 0; i < name_len; i++)
+        name[i] = (unsigned char) start[i];
+    name[name_len] = '\0';
+    TCHAR *period = _tcsrchr(name, '.');
+    if (period)
+        *period = '\0';
+    TCHAR *dash = _tcsrchr(name, '-');
+    if (!dash)
+        return 0;
+    return lookup_compiler_exe(dash + 1, NULL);
+}
+
+static size_t skip_space(const char *buf, size_t pos, size_t len) {
+    while (pos < len && isspace((unsigned char) buf[pos]))
+        pos++;
+    return pos;
+}
+
+// Find the end of a JSON string starting at pos (after the opening
+// quote), returning the position of the closing quote.
+static size_t string_end(const char *buf, size_t pos, size_t len) {
+    while (pos < len && buf[pos] != '"') {
+        if (buf[pos] == '\\')
+            pos++;
+        pos++;
+    }
+    return pos < len ? pos : len;
+}
+
+// Write a copy of a compilation database, with "-target DEFAULT_TARGET"
+// added to all commands that don't invoke a <triple>-<exe> style
+// compiler, which is what we'd do for a single command. This only
+// tokenizes the JSON as much as is necessary to find the "command" and
+// "arguments" values.
+static int rewrite_compdb(const TCHAR *in_path, const TCHAR *out_path) {
+    FILE *in = _tfopen(in_path, _T("rb"));
+    if (!in)
+        return 0;
+    fseek(in, 0, SEEK_END);
+    long len = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    char *buf = malloc(len + 1);
+    if (len < 0 || !buf || fread(buf, 1, len, in) != (size_t) len) {
+        fclose(in);
+        return 0;
+    }
+    fclose(in);
+    FILE *out = _tfopen(out_path, _T("wb"));
+    if (!out) {
+        free(buf);
+        return 0;
+    }
+
+    size_t copied = 0;
+    size_t pos = 0;
+    while (pos < (size_t) len) {
+        if (buf[pos] != '"') {
+            pos++;
+            continue;
+        }
+        size_t key = pos + 1;
+        size_t key_end = string_end(buf, key, len);
+        pos = skip_space(buf, key_end + 1, len);
+        if (pos >= (size_t) len || buf[pos] != ':')
+            continue;
+        size_t key_len = key_end - key;
+        pos = skip_space(buf, pos + 1, len);
+        size_t insert_pos = 0;
+        const char *insert = NULL;
+        if (key_len == 7 && !memcmp(buf + key, "command", 7) && buf[pos] == '"') {
+            size_t word = skip_space(buf, pos + 1, len);
+            size_t word_end;
+            if (!strncmp(buf + word, "\\\"", 2)) {
+                // A quoted executable name
+                word += 2;
+                word_end = word;
+                while (word_end < (size_t) len && strncmp(buf + word_end, "\\\"", 2) && buf[word_end] != '"')
+                    word_end++;
+                insert_pos = word_end + (buf[word_end] == '\\' ? 2 : 0);
+            } else {
+                word_end = word;
+                while (word_end < (size_t) len && buf[word_end] != ' ' && buf[word_end] != '"')
+                    word_end++;
+                insert_pos = word_end;
+            }
+            if (!cmd_has_target(buf + word, word_end - word))
+                insert = " -target " DEFAULT_TARGET;
+        } else if (key_len == 9 && !memcmp(buf + key, "arguments", 9) && buf[pos] == '[') {
+            size_t word = skip_space(buf, pos + 1, len);
+            if (buf[word] == '"') {
+                size_t word_end = string_end(buf, word + 1, len);
+                insert_pos = word_end + 1;
+                if (!cmd_has_target(buf + word + 1, word_end - word - 1))
+                    insert = ", \"-target\", \"" DEFAULT_TARGET "\"";
+            }
+        }
+        if (insert) {
+            fwrite(buf + copied, 1, insert_pos - copied, out);
+            fputs(insert, out);
+            copied = insert_pos;
+        }
+    }
+    fwrite(buf + copied, 1, len - copied, out);
+    free(buf);
+    return fclose(out) == 0;
+}
+#endif
+
 int _tmain(int argc, TCHAR *argv[]) {
     const TCHAR *dir;
     split_argv(argv[0], &dir, NULL, NULL, NULL);
@@ -38,6 +159,11 @@ int _tmain(int argc, TCHAR *argv[]) {
     int i = 1;
     int got_flags = 0;
     TCHAR *cmd_exe = NULL;
+#ifdef _WIN32
+    const TCHAR *compdb = NULL;
+    const TCHAR *compdb_opt = NULL;
+    int compdb_arg = 0;
+#endif
     for (; i < argc; i++) {
         if (got_flags) {
             cmd_exe = _tcsdup(argv[i]);
@@ -47,6 +173,29 @@ int _tmain(int argc, TCHAR *argv[]) {
         } else if (!_tcscmp(argv[i], _T("--"))) {
             got_flags = 1;
             exec_argv[arg++] = argv[i];
+#ifdef _WIN32
+        } else if ((!_tcscmp(argv[i], _T("-compilation-database")) ||
+                    !_tcscmp(argv[i], _T("--compilation-database"))) && i + 1 < argc) {
+            // In compilation database mode, clang-scan-deps already scans
+            // all the entries in parallel (see -j), sharing one filesystem
+            // cache. Add the default target to each entry, like we do
+            // for a single command below.
+            exec_argv[arg++] = argv[i++];
+            compdb = argv[i];
+            compdb_opt = _T("");
+            compdb_arg = arg;
+            exec_argv[arg++] = compdb;
+        } else if (!_tcsncmp(argv[i], _T("-compilation-database="), 22) ||
+                   !_tcsncmp(argv[i], _T("--compilation-database="), 23)) {
+            // The same, with the path joined to the option.
+            const TCHAR *equals = _tcschr(argv[i], '=');
+            compdb = equals + 1;
+            TCHAR *opt = _tcsdup(argv[i]);
+            opt[equals + 1 - argv[i]] = '\0';
+            compdb_opt = opt;
+            compdb_arg = arg;
+            exec_argv[arg++] = argv[i];
+#endif
         } else {
             exec_argv[arg++] = argv[i];
         }
@@ -67,17 +216,7 @@ int _tmain(int argc, TCHAR *argv[]) {
         if (dash) {
             *dash = '\0';
             const TCHAR *cmd_exe_suffix = dash + 1;
-            if (!_tcscmp(cmd_exe_suffix, _T("clang")) ||
-                !_tcscmp(cmd_exe_suffix, _T("clang++")) ||
-                !_tcscmp(cmd_exe_suffix, _T("gcc")) ||
-                !_tcscmp(cmd_exe_suffix, _T("g++")) ||
-                !_tcscmp(cmd_exe_suffix, _T("c++")) ||
-                !_tcscmp(cmd_exe_suffix, _T("as")) ||
-                !_tcscmp(cmd_exe_suffix, _T("cc")) ||
-                !_tcscmp(cmd_exe_suffix, _T("c99")) ||
-                !_tcscmp(cmd_exe_suffix, _T("c11"))) {
-                has_target = 1;
-            }
+            has_target = lookup_compiler_exe(cmd_exe_suffix, NULL);
         }
         const TCHAR *target = NULL;
 #ifdef _WIN32
@@ -105,5 +244,29 @@ int _tmain(int argc, TCHAR *argv[]) {
         abort();
     }
 
+#ifdef _WIN32
+    TCHAR *temp_compdb = NULL;
+    if (compdb) {
+        TCHAR temp_path[MAX_PATH];
+        temp_compdb = malloc(MAX_PATH * sizeof(*temp_compdb));
+        // GetTempFileName creates the file; remove it if we fail after that.
+        if (GetTempPath(MAX_PATH, temp_path) == 0 ||
+            GetTempFileName(temp_path, _T("csd"), 0, temp_compdb) == 0) {
+            _ftprintf(stderr, _T("Unable to rewrite compilation database "TS"\n"), compdb);
+            return 1;
+        }
+        if (!rewrite_compdb(compdb, temp_compdb)) {
+            _ftprintf(stderr, _T("Unable to rewrite compilation database "TS"\n"), compdb);
+            DeleteFile(temp_compdb);
+            return 1;
+        }
+        exec_argv[compdb_arg] = concat(compdb_opt, temp_compdb);
+    }
+    int ret = run_final(exec_argv[0], exec_argv);
+    if (temp_compdb)
+        DeleteFile(temp_compdb);
+    return ret;
+#else
     return run_final(exec_argv[0], exec_argv);
+#endif
 }
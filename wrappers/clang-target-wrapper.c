@@ -18,6 +18,10 @@
 
 #include "native-wrapper.h"
 
+#ifdef _WIN32
+#include <io.h>
+#endif
+
 #ifndef CLANG
 #define CLANG "clang"
 #endif
@@ -25,13 +29,420 @@
 #define DEFAULT_TARGET "x86_64-w64-mingw32"
 #endif
 
+// Check whether an option is one of the common ones that take their value
+// as a separate argument.
+static int has_separate_value(const TCHAR *opt) {
+    return !_tcscmp(opt, _T("-o")) || !_tcscmp(opt, _T("-I")) ||
+           !_tcscmp(opt, _T("-L")) || !_tcscmp(opt, _T("-D")) ||
+           !_tcscmp(opt, _T("-U")) || !_tcscmp(opt, _T("-target")) ||
+           !_tcscmp(opt, _T("-include")) || !_tcscmp(opt, _T("-isystem")) ||
+           !_tcscmp(opt, _T("-imacros")) || !_tcscmp(opt, _T("-iquote")) ||
+           !_tcscmp(opt, _T("-idirafter")) ||
+           !_tcscmp(opt, _T("-Xlinker")) || !_tcscmp(opt, _T("-Xclang")) ||
+           !_tcscmp(opt, _T("-MF")) || !_tcscmp(opt, _T("-MT")) ||
+           !_tcscmp(opt, _T("-MQ"));
+}
+
+// Check whether the command line will invoke the linker. Err on the side
+// of not treating it as a link; this is only used for adding linker
+// options that are optimizations.
+static int is_link(int argc, TCHAR *argv[]) {
+    int inputs = 0;
+    for (int i = 1; i < argc; i++) {
+        const TCHAR *opt = argv[i];
+        if (opt[0] != '-') {
+            inputs++;
+            continue;
+        }
+        if (has_separate_value(opt)) {
+            i++;
+            continue;
+        }
+        if (!_tcscmp(opt, _T("-c")) || !_tcscmp(opt, _T("-S")) ||
+            !_tcscmp(opt, _T("-E")) || !_tcscmp(opt, _T("-M")) ||
+            !_tcscmp(opt, _T("-MM")) || !_tcscmp(opt, _T("-fsyntax-only")) ||
+            !_tcscmp(opt, _T("--precompile")) || !_tcscmp(opt, _T("-###")) ||
+            !_tcscmp(opt, _T("--version")) || !_tcscmp(opt, _T("-dumpmachine")) ||
+            !_tcscmp(opt, _T("-dumpversion")) || !_tcsncmp(opt, _T("-print-"), 7) ||
+            !_tcsncmp(opt, _T("--print-"), 8))
+            return 0;
+        // Precompiling a header, with "-x c-header" or "-xc++-header".
+        if (!_tcsncmp(opt, _T("-x"), 2)) {
+            const TCHAR *lang = opt[2] ? opt + 2 : (i + 1 < argc ? argv[i + 1] : _T(""));
+            size_t len = _tcslen(lang);
+            if (len >= 7 && !_tcscmp(lang + len - 7, _T("-header")))
+                return 0;
+            if (!opt[2])
+                i++;
+        }
+    }
+    // Without any input files, clang won't link (e.g. "clang -v"), unless
+    // we add linker inputs like -Wl options ourselves.
+    return inputs > 0;
+}
+
+// Check whether the command line compiles a single source file with -c.
+static int is_single_compile(int argc, TCHAR *argv[]) {
+    int inputs = 0, compile = 0;
+    for (int i = 1; i < argc; i++) {
+        const TCHAR *opt = argv[i];
+        if (opt[0] != '-')
+            inputs++;
+        else if (has_separate_value(opt) || !_tcscmp(opt, _T("-x")))
+            i++;
+        else if (!_tcscmp(opt, _T("-c")))
+            compile = 1;
+    }
+    return compile && inputs == 1;
+}
+
+// Check whether the command line uses some other C++ standard library
+// than the libc++ that the std module was prebuilt from.
+static int other_stdlib(int argc, TCHAR *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (!_tcscmp(argv[i], _T("-nostdinc++")) || !_tcscmp(argv[i], _T("-nostdlib++")) ||
+            !_tcscmp(argv[i], _T("-nostdlib")) || !_tcscmp(argv[i], _T("-nodefaultlibs")) ||
+            !_tcsncmp(argv[i], _T("-stdlib="), 8))
+            return 1;
+    }
+    return 0;
+}
+
+// Check whether the command line picks a different target or its own config
+// files; then leave it to clang to find the config files and sysroot.
+static int overrides_config(int argc, TCHAR *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (!_tcscmp(argv[i], _T("-target")) || !_tcsncmp(argv[i], _T("--target="), 9) ||
+            !_tcsncmp(argv[i], _T("--config"), 8) || !_tcscmp(argv[i], _T("--no-default-config")))
+            return 1;
+    }
+    return 0;
+}
+
+// If the std module has been prebuilt for the language mode requested on
+// the command line, return the directory containing it. Skip this if some
+// other C++ standard library is used.
+//
+// Clang checks the language options stored in the module file against
+// the ones of the current compilation, so options like -fno-exceptions
+// or -fno-rtti make it reject importing the prebuilt std module, with an
+// error about the mismatch. Keep passing the module path in that case, to
+// get that error, rather than a less obvious one about std not being
+// found.
+static const TCHAR *prebuilt_module_path(const TCHAR *dir, const TCHAR *arch, int argc, TCHAR *argv[]) {
+    const TCHAR *std = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!_tcsncmp(argv[i], _T("-std="), 5))
+            std = argv[i] + 5;
+    }
+    if (other_stdlib(argc, argv))
+        return NULL;
+    if (!std || (_tcsncmp(std, _T("c++"), 3) && _tcsncmp(std, _T("gnu++"), 5)))
+        return NULL;
+    TCHAR *path = concat(dir, concat(_T("../"), concat(arch, concat(_T("-w64-mingw32/lib/modules/"), std))));
+    FILE *f = _tfopen(concat(path, _T("/std.pcm")), _T("rb"));
+    if (!f)
+        return NULL;
+    fclose(f);
+    return path;
+}
+
+// Check whether the first thing in a source file, after comments, is an
+// include of windows.h. Only then is it safe to include the precompiled
+// windows.h before it; macros defined in the source before including it
+// (like UNICODE or NOMINMAX) would change its meaning, and files not
+// including it at all shouldn't see its macros.
+static int includes_windows_h_first(const TCHAR *path) {
+    FILE *f = _tfopen(path, _T("rb"));
+    if (!f)
+        return 0;
+    char buf[8192];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    const char *p = buf;
+    if (!strncmp(p, "\xef\xbb\xbf", 3))
+        p += 3;
+    while (1) {
+        while (isspace((unsigned char) *p))
+            p++;
+        if (!strncmp(p, "//", 2)) {
+            p = strchr(p, '\n');
+            if (!p)
+                return 0;
+        } else if (!strncmp(p, "/*", 2)) {
+            p = strstr(p + 2, "*/");
+            if (!p)
+                return 0;
+            p += 2;
+        } else {
+            break;
+        }
+    }
+    if (*p++ != '#')
+        return 0;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (strncmp(p, "include", 7))
+        return 0;
+    p += 7;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p != '<' && *p != '"')
+        return 0;
+    char end = *p == '<' ? '>' : '"';
+    p++;
+    const char *name = "windows.h";
+    for (int i = 0; name[i]; i++)
+        if (tolower((unsigned char) p[i]) != name[i])
+            return 0;
+    return p[9] == end;
+}
+
+// Get the value of an option that takes a value either joined or as a
+// separate argument, like -DFOO or -D FOO, or NULL if argv[*i] isn't that
+// option.
+static const TCHAR *option_value(const TCHAR *name, int argc, TCHAR *argv[], int *i) {
+    size_t len = _tcslen(name);
+    if (_tcsncmp(argv[*i], name, len))
+        return NULL;
+    if (argv[*i][len])
+        return argv[*i] + len;
+    if (*i + 1 < argc)
+        return argv[++*i];
+    return NULL;
+}
+
+// Check whether any of the lines in a file (as written by
+// build-windows-pch.sh) is accepted by the given function.
+static int any_line(const TCHAR *path, int (*func)(const TCHAR *line, void *arg), void *arg) {
+    FILE *f = _tfopen(path, _T("r"));
+    if (!f)
+        return 1;
+    TCHAR buf[1024];
+    int found = 0;
+    while (!found && _fgetts(buf, sizeof(buf)/sizeof(buf[0]), f)) {
+        size_t len = _tcslen(buf);
+        while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+            buf[--len] = '\0';
+        found = func(buf, arg);
+    }
+    fclose(f);
+    return found;
+}
+
+struct names {
+    const TCHAR **names;
+    int n;
+};
+
+// Check whether an identifier is one of the macro names, given as the
+// values of -D or -U options (including any "=value").
+static int is_macro(const TCHAR *ident, void *arg) {
+    const struct names *macros = arg;
+    size_t len = _tcslen(ident);
+    for (int i = 0; i < macros->n; i++)
+        if (!_tcsncmp(macros->names[i], ident, len) &&
+            (macros->names[i][len] == '\0' || macros->names[i][len] == '='))
+            return 1;
+    return 0;
+}
+
+// Check whether a header exists in any of the include directories.
+static int in_include_dirs(const TCHAR *header, void *arg) {
+    const struct names *dirs = arg;
+    for (int i = 0; i < dirs->n; i++) {
+        FILE *f = _tfopen(concat(dirs->names[i], concat(_T("/"), header)), _T("rb"));
+        if (f) {
+            fclose(f);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Add the directories listed in an environment variable like CPATH.
+static void add_env_dirs(struct names *dirs, const TCHAR *var) {
+    const TCHAR *value = _tgetenv(var);
+    if (!value || !*value)
+        return;
+    TCHAR *copy = _tcsdup(value);
+    for (TCHAR *ptr = copy; ptr; ) {
+        TCHAR *sep = _tcschr(ptr, PATH_SEP[0]);
+        if (sep)
+            *sep = '\0';
+        if (*ptr) {
+            dirs->names = realloc(dirs->names, (dirs->n + 1) * sizeof(*dirs->names));
+            dirs->names[dirs->n++] = ptr;
+        }
+        ptr = sep ? sep + 1 : NULL;
+    }
+}
+
+// If LLVM_MINGW_WINDOWS_PCH is set, return the precompiled windows.h that
+// build-windows-pch.sh built for the language, optimization level and the
+// _WIN32_WINNT, WIN32_LEAN_AND_MEAN and UNICODE macros of the command
+// line, if there is one. The source file must start by including
+// windows.h.
+//
+// Clang checks that the other language options, the target and the
+// predefined macros match the ones the header was built with, and rejects
+// it otherwise (see compile_with_pch). It doesn't check whether macros
+// defined on the command line, or include directories, would have changed
+// the contents of the header; check that here, against the identifiers
+// and headers that build-windows-pch.sh found in it.
+static const TCHAR *windows_pch(const TCHAR *dir, const TCHAR *arch, int cplusplus, int argc, TCHAR *argv[]) {
+    if (!getenv("LLVM_MINGW_WINDOWS_PCH") || !is_single_compile(argc, argv))
+        return NULL;
+    int lean = 0, unicode = 0, tunicode = 0, optimize = 0;
+    const TCHAR *winnt = NULL, *source = NULL, *lang = NULL, *value;
+    struct names macros = { malloc(argc * sizeof(*macros.names)), 0 };
+    struct names dirs = { malloc(argc * sizeof(*dirs.names)), 0 };
+    for (int i = 1; i < argc; i++) {
+        const TCHAR *opt = argv[i];
+        if (opt[0] != '-') {
+            source = opt;
+        } else if (!_tcsncmp(opt, _T("-include"), 8) || !_tcsncmp(opt, _T("-imacros"), 8) ||
+                   !_tcsncmp(opt, _T("-Wp,"), 4)) {
+            // Headers included before the source file would be included
+            // after the precompiled one; -Wp, can pass anything to the
+            // preprocessor.
+            return NULL;
+        } else if (!_tcscmp(opt, _T("-nostdinc")) || !_tcscmp(opt, _T("-nostdlibinc")) ||
+                   !_tcscmp(opt, _T("-nobuiltininc")) || !_tcsncmp(opt, _T("--sysroot"), 9) ||
+                   !_tcsncmp(opt, _T("-isysroot"), 9)) {
+            // Options that change the system include directories that the
+            // header was found in.
+            return NULL;
+        } else if ((value = option_value(_T("-D"), argc, argv, &i))) {
+            if (!_tcscmp(value, _T("WIN32_LEAN_AND_MEAN")) || !_tcscmp(value, _T("WIN32_LEAN_AND_MEAN=1")))
+                lean = 1;
+            else if (!_tcscmp(value, _T("UNICODE")) || !_tcscmp(value, _T("UNICODE=1")))
+                unicode = 1;
+            else if (!_tcscmp(value, _T("_UNICODE")) || !_tcscmp(value, _T("_UNICODE=1")))
+                tunicode = 1;
+            else if (!_tcsncmp(value, _T("_WIN32_WINNT="), 13))
+                winnt = value + 13;
+            else
+                macros.names[macros.n++] = value;
+        } else if ((value = option_value(_T("-U"), argc, argv, &i))) {
+            macros.names[macros.n++] = value;
+        } else if ((value = option_value(_T("-I"), argc, argv, &i)) ||
+                   (value = option_value(_T("-isystem"), argc, argv, &i)) ||
+                   (value = option_value(_T("-iquote"), argc, argv, &i))) {
+            dirs.names[dirs.n++] = value;
+        } else if ((value = option_value(_T("-x"), argc, argv, &i))) {
+            lang = value;
+        } else if (!_tcsncmp(opt, _T("-O"), 2)) {
+            optimize = _tcscmp(opt, _T("-O0")) != 0;
+        } else if (has_separate_value(opt)) {
+            i++;
+        }
+    }
+    if (!source || unicode != tunicode || !includes_windows_h_first(source))
+        return NULL;
+    if (!lang) {
+        const TCHAR *ext = _tcsrchr(source, '.');
+        lang = cplusplus || (ext && (!_tcscmp(ext, _T(".cpp")) || !_tcscmp(ext, _T(".cc")) ||
+                                     !_tcscmp(ext, _T(".cxx")) || !_tcscmp(ext, _T(".C")))) ?
+               _T("c++") : _T("c");
+    }
+    if (_tcscmp(lang, _T("c")) && _tcscmp(lang, _T("c++")))
+        return NULL;
+    TCHAR *base = concat(dir, concat(_T("../"), concat(arch, concat(_T("-w64-mingw32/lib/pch/windows-"), lang))));
+    TCHAR *path = base;
+    if (optimize)
+        path = concat(path, _T("-opt"));
+    if (winnt)
+        path = concat(path, concat(_T("-"), winnt));
+    if (lean)
+        path = concat(path, _T("-lean"));
+    if (unicode)
+        path = concat(path, _T("-unicode"));
+    path = concat(path, _T(".pch"));
+    FILE *f = _tfopen(path, _T("rb"));
+    if (!f)
+        return NULL;
+    fclose(f);
+    if (macros.n > 0 && any_line(concat(base, _T(".idents")), is_macro, &macros))
+        return NULL;
+    add_env_dirs(&dirs, _T("CPATH"));
+    add_env_dirs(&dirs, cplusplus ? _T("CPLUS_INCLUDE_PATH") : _T("C_INCLUDE_PATH"));
+    if (dirs.n > 0 && any_line(concat(base, _T(".headers")), in_include_dirs, &dirs))
+        return NULL;
+    return path;
+}
+
+// Open an anonymous temporary file.
+static FILE *open_temp_file(void) {
+#ifdef _WIN32
+    TCHAR dir[MAX_PATH], path[MAX_PATH];
+    if (!GetTempPath(MAX_PATH, dir) || !GetTempFileName(dir, _T("ctw"), 0, path))
+        return NULL;
+    // "D" makes the file get deleted once closed.
+    return _tfopen(path, _T("w+bD"));
+#else
+    return tmpfile();
+#endif
+}
+
+// Compile with the precompiled windows.h, capturing the diagnostics. If
+// clang rejects the precompiled header, as the command line isn't
+// compatible with the options it was built with, return -1, to let the
+// caller compile without it instead. Otherwise print the diagnostics and
+// return the exit code.
+static int compile_with_pch(const TCHAR *const *argv) {
+    FILE *err = open_temp_file();
+    if (!err)
+        return -1;
+    fflush(stderr);
+    int saved_stderr = dup(2);
+    dup2(fileno(err), 2);
+    int ret = run_child(argv[0], argv);
+    dup2(saved_stderr, 2);
+    close(saved_stderr);
+    fseek(err, 0, SEEK_END);
+    long size = ftell(err);
+    char *buf = malloc(size + 1);
+    fseek(err, 0, SEEK_SET);
+    size = size > 0 ? fread(buf, 1, size, err) : 0;
+    buf[size] = '\0';
+    fclose(err);
+    // The errors clang gives when rejecting a precompiled header all
+    // mention it as "PCH file", "precompiled header" or "AST file". Don't
+    // redo compilations that failed for other reasons.
+    if (ret && (strstr(buf, "PCH") || strstr(buf, "precompiled") || strstr(buf, "AST file")))
+        return -1;
+    fwrite(buf, 1, size, stderr);
+    return ret;
+}
+
+// Check whether the stat caches in the given directory were generated for
+// the toolchain at root. The caches contain absolute paths, so they can't
+// be used if the toolchain has been moved since.
+static int stat_cache_valid(const TCHAR *cache_dir, const TCHAR *root) {
+    FILE *f = _tfopen(concat(cache_dir, _T("root")), _T("r"));
+    if (!f)
+        return 0;
+    TCHAR buf[1024];
+    int valid = 0;
+    if (_fgetts(buf, sizeof(buf)/sizeof(buf[0]), f)) {
+        size_t len = _tcslen(buf);
+        while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+            buf[--len] = '\0';
+        valid = !_tcscmp(buf, root);
+    }
+    fclose(f);
+    return valid;
+}
+
 int _tmain(int argc, TCHAR* argv[]) {
     const TCHAR *dir;
     const TCHAR *target;
     const TCHAR *exe;
     split_argv(argv[0], &dir, NULL, &target, &exe);
     if (!target)
-        target = _T(DEFAULT_TARGET);
+        target = invocation.target = _T(DEFAULT_TARGET);
     TCHAR *arch = _tcsdup(target);
     TCHAR *dash = _tcschr(arch, '-');
     if (dash)
@@ -50,21 +461,90 @@ int _tmain(int argc, TCHAR* argv[]) {
         }
     }
 
-    int max_arg = argc + 18;
+    int max_arg = argc + 38;
     const TCHAR **exec_argv = malloc((max_arg + 1) * sizeof(*exec_argv));
     int arg = 0;
-    if (getenv("CCACHE"))
+    int pch_arg = -1, pch_args = 0;
+    TCHAR *cfg = concat(dir, concat(arch, _T("-w64-windows-gnu.cfg")));
+    FILE *f = _tfopen(cfg, _T("r"));
+    if (f)
+        fclose(f);
+    else
+        cfg = NULL;
+    // Allow setting LLVM_MINGW_BASEDIR to the root directory of the source
+    // being built, to make the output independent of the location of it
+    // (and of the toolchain), to allow reusing cached objects across
+    // different checkouts.
+    TCHAR *basedir = _tgetenv(_T("LLVM_MINGW_BASEDIR"));
+    if (basedir && *basedir) {
+        basedir = _tcsdup(basedir);
+        size_t len = _tcslen(basedir);
+        while (len > 1 && (basedir[len - 1] == '/' || basedir[len - 1] == '\\'))
+            basedir[--len] = '\0';
+    } else {
+        basedir = NULL;
+    }
+    // The config file for the target and the sysroot are known; pass them
+    // explicitly, to avoid clang searching for them (looking for a matching
+    // gcc in PATH etc) on every invocation. The toolchain is built without
+    // user or system config directories, so clang wouldn't find any other
+    // config files by default. Don't do this if the user picks another
+    // target or config file.
+    int own_config = !overrides_config(argc, argv);
+    if (getenv("CCACHE")) {
         exec_argv[arg++] = _T("ccache");
+        // Let ccache know about the config file that we pass to clang, and
+        // the common one that it includes, so that changes to them
+        // invalidate cached objects. (If the user passes their own config
+        // files, they are visible on the command line that ccache hashes.)
+        if (own_config && cfg) {
+            const TCHAR *cfgs = cfg;
+            TCHAR *common = concat(dir, _T("mingw32-common.cfg"));
+            f = _tfopen(common, _T("r"));
+            if (f) {
+                fclose(f);
+                cfgs = concat(cfgs, concat(PATH_SEP, common));
+            }
+            const TCHAR *extrafiles = _tgetenv(_T("CCACHE_EXTRAFILES"));
+            _tputenv(concat(_T("CCACHE_EXTRAFILES="),
+                            extrafiles && *extrafiles ? concat(concat(extrafiles, PATH_SEP), cfgs) : cfgs));
+        }
+        // Let ccache treat paths below the base directory as relative.
+        if (basedir && !getenv("CCACHE_BASEDIR"))
+            _tputenv(concat(_T("CCACHE_BASEDIR="), basedir));
+        // Let ccache invoke distcc on cache misses, unless the user has
+        // set some other prefix command.
+        if (getenv("DISTCC") && !getenv("CCACHE_PREFIX"))
+            _tputenv(_T("CCACHE_PREFIX=distcc"));
+    } else if (getenv("DISTCC")) {
+        exec_argv[arg++] = _T("distcc");
+    }
     exec_argv[arg++] = concat(dir, _T(CLANG));
     exec_argv[arg++] = _T("--start-no-unused-arguments");
 
+    const TCHAR *root = toolchain_root(dir);
+    if (own_config) {
+        if (cfg) {
+            exec_argv[arg++] = _T("--no-default-config");
+            exec_argv[arg++] = concat(_T("--config="), cfg);
+        }
+        if (root)
+            exec_argv[arg++] = concat(_T("--sysroot="), root);
+    }
+
+    if (basedir) {
+        exec_argv[arg++] = concat(_T("-ffile-prefix-map="), concat(basedir, _T("=.")));
+        if (root)
+            exec_argv[arg++] = concat(_T("-ffile-prefix-map="), concat(root, _T("=/llvm-mingw")));
+        exec_argv[arg++] = _T("-ffile-compilation-dir=.");
+    }
+
     // If changing this wrapper, change clang-target-wrapper.sh accordingly.
-    if (!_tcscmp(exe, _T("clang++")) || !_tcscmp(exe, _T("g++")) || !_tcscmp(exe, _T("c++")))
-        exec_argv[arg++] = _T("--driver-mode=g++");
-    else if (!_tcscmp(exe, _T("c99")))
-        exec_argv[arg++] = _T("-std=c99");
-    else if (!_tcscmp(exe, _T("c11")))
-        exec_argv[arg++] = _T("-std=c11");
+    const TCHAR *exe_flag;
+    lookup_compiler_exe(exe, &exe_flag);
+    if (exe_flag)
+        exec_argv[arg++] = exe_flag;
+    int cplusplus = exe_flag && !_tcscmp(exe_flag, _T("--driver-mode=g++"));
 
     if (target_os && !_tcscmp(target_os, _T("mingw32uwp"))) {
         // the UWP target is for Windows 10
@@ -78,6 +558,108 @@ int _tmain(int argc, TCHAR* argv[]) {
         exec_argv[arg++] = _T("-D_UCRT");
     }
 
+    // The UWP defines would make the prebuilt std module and windows.h
+    // incompatible.
+    if (!target_os || _tcscmp(target_os, _T("mingw32uwp"))) {
+        const TCHAR *module_path = prebuilt_module_path(dir, arch, argc, argv);
+        if (module_path)
+            exec_argv[arg++] = concat(_T("-fprebuilt-module-path="), module_path);
+        const TCHAR *pch = windows_pch(dir, arch, cplusplus, argc, argv);
+        if (pch) {
+            pch_arg = arg;
+            exec_argv[arg++] = _T("-include-pch");
+            exec_argv[arg++] = pch;
+#ifndef _WIN32
+            // Keep the colors of the diagnostics, even though clang's
+            // output is captured. (Any option from the user comes later
+            // and takes precedence.) On Windows, clang sets the colors
+            // through the console instead, which doesn't work when the
+            // output is captured.
+            if (isatty(2))
+                exec_argv[arg++] = _T("-fcolor-diagnostics");
+#endif
+            pch_args = arg - pch_arg;
+        }
+    }
+
+    // With LLVM_MINGW_STAT_CACHE=1, use the stat caches generated by
+    // build-stat-cache.sh, if available and generated for this location of
+    // the toolchain.
+    const TCHAR *stat_cache_dir = concat(dir, concat(_T("../"), concat(arch, _T("-w64-mingw32/lib/statcache/"))));
+    if (getenv("LLVM_MINGW_STAT_CACHE") && root && stat_cache_valid(stat_cache_dir, root)) {
+        const TCHAR *stat_caches[] = { _T("include"), _T("resource-include") };
+        for (size_t i = 0; i < sizeof(stat_caches) / sizeof(stat_caches[0]); i++) {
+            TCHAR *path = concat(stat_cache_dir, concat(stat_caches[i], _T(".statcache")));
+            FILE *f = _tfopen(path, _T("rb"));
+            if (f) {
+                fclose(f);
+                exec_argv[arg++] = _T("-ivfsstatcache");
+                exec_argv[arg++] = path;
+            }
+        }
+    }
+
+    // With LLVM_MINGW_TIME_TRACE=<dir>, write a time trace for each
+    // compilation of a source file into <dir>/<arch>, for
+    // time-trace-report.sh. If the output file is known, name the trace
+    // after it and our process id, as clang would otherwise name it after
+    // the output file only, and the same file name often is used in
+    // multiple directories of a build.
+    const TCHAR *time_trace = _tgetenv(_T("LLVM_MINGW_TIME_TRACE"));
+    if (time_trace && *time_trace && is_single_compile(argc, argv)) {
+        TCHAR *trace_dir = concat(time_trace, concat(_T("/"), arch));
+        make_dirs(trace_dir);
+        const TCHAR *output = NULL;
+        for (int i = 1; i < argc - 1; i++)
+            if (!_tcscmp(argv[i], _T("-o")))
+                output = argv[i + 1];
+        if (output) {
+            const TCHAR *sep = _tcsrchrs(output, '/', '\\');
+            const TCHAR *name = concat(_T("/"), sep ? sep + 1 : output);
+#ifdef _WIN32
+            int pid = GetCurrentProcessId();
+#else
+            int pid = getpid();
+#endif
+            const TCHAR *trace = concat_int(concat(trace_dir, concat(name, _T("."))), pid);
+            exec_argv[arg++] = concat(_T("-ftime-trace="), concat(trace, _T(".json")));
+        } else {
+            exec_argv[arg++] = concat(_T("-ftime-trace="), concat(trace_dir, _T("/")));
+        }
+        const TCHAR *granularity = _tgetenv(_T("LLVM_MINGW_TIME_TRACE_GRANULARITY"));
+        if (granularity && *granularity)
+            exec_argv[arg++] = concat(_T("-ftime-trace-granularity="), granularity);
+    }
+
+    // If running under a parallel make, let the linker use as many threads
+    // as there are free job slots, instead of all cores. Also let ThinLTO
+    // links reuse the backend outputs for unchanged modules, if a cache
+    // directory is configured, and run the backends as separate processes,
+    // if a distributor is configured. This is passed before the user
+    // provided options, so that those take precedence, and within the
+    // --start-no-unused-arguments block, in case is_link guessed wrong.
+    if (is_link(argc, argv)) {
+        const TCHAR *distributor = thinlto_distributor(dir);
+        if (distributor) {
+            // Leave the job slots to the distributor.
+            exec_argv[arg++] = concat(_T("-Wl,--thinlto-distributor="), distributor);
+            exec_argv[arg++] = concat(_T("-Wl,--thinlto-remote-compiler="), concat(dir, concat(_T(CLANG), EXE_SUFFIX)));
+        } else {
+            int jobs = jobserver_acquire();
+            if (jobs > 0) {
+                exec_argv[arg++] = concat_int(_T("-Wl,--threads="), jobs);
+                exec_argv[arg++] = concat_int(_T("-Wl,--thinlto-jobs="), jobs);
+            }
+        }
+        const TCHAR *cache_dir = thinlto_cache_dir();
+        if (cache_dir) {
+            exec_argv[arg++] = concat(_T("-Wl,--thinlto-cache-dir="), cache_dir);
+            const TCHAR *policy = _tgetenv(_T("LLVM_MINGW_THINLTO_CACHE_POLICY"));
+            if (policy && *policy)
+                exec_argv[arg++] = concat(_T("-Wl,--thinlto-cache-policy="), policy);
+        }
+    }
+
     exec_argv[arg++] = _T("-target");
     exec_argv[arg++] = target;
     exec_argv[arg++] = _T("--end-no-unused-arguments");
@@ -85,6 +667,19 @@ int _tmain(int argc, TCHAR* argv[]) {
     for (int i = 1; i < argc; i++)
         exec_argv[arg++] = argv[i];
 
+    // The objects from compiling the prebuilt std modules contain the
+    // module initializers that code importing them refers to. Link them in
+    // for C++ links; the linker only pulls them in if they are referenced.
+    if ((!target_os || _tcscmp(target_os, _T("mingw32uwp"))) && cplusplus &&
+        !other_stdlib(argc, argv) && is_link(argc, argv)) {
+        TCHAR *path = concat(dir, concat(_T("../"), concat(arch, _T("-w64-mingw32/lib/modules/libstd-modules.a"))));
+        FILE *f = _tfopen(path, _T("rb"));
+        if (f) {
+            fclose(f);
+            exec_argv[arg++] = path;
+        }
+    }
+
     if (target_os && !_tcscmp(target_os, _T("mingw32uwp"))) {
         // Default linker flags; passed after any user specified -l options,
         // to let the user specified libraries take precedence over these.
@@ -104,5 +699,14 @@ int _tmain(int argc, TCHAR* argv[]) {
         abort();
     }
 
+    if (pch_arg >= 0) {
+        int ret = compile_with_pch(exec_argv);
+        if (ret >= 0)
+            return ret;
+        // Clang rejected the precompiled header; compile without it.
+        memmove(&exec_argv[pch_arg], &exec_argv[pch_arg + pch_args],
+                (arg + 1 - pch_arg - pch_args) * sizeof(*exec_argv));
+    }
+
     return run_final(exec_argv[0], exec_argv);
 }
@@ -53,6 +53,9 @@ if [ -n "$CCACHE" ]; then
 fi
 
 # If changing this wrapper, change clang-target-wrapper.c accordingly.
+# This fallback only implements the basic behavior; the options described
+# under "Wrapper options" in README.md (DISTCC, the LLVM_MINGW_* variables
+# and the jobserver handling) are only implemented in clang-target-wrapper.c.
 CLANG="$DIR/clang"
 FLAGS=""
 FLAGS="$FLAGS --start-no-unused-arguments"
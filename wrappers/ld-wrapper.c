@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2026 Martin Storsjo
+ *
+ * This file is part of llvm-mingw.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "native-wrapper.h"
+
+#ifndef CLANG
+#define CLANG "clang"
+#endif
+#ifndef DEFAULT_TARGET
+#define DEFAULT_TARGET "x86_64-w64-mingw32"
+#endif
+
+int _tmain(int argc, TCHAR* argv[]) {
+    const TCHAR *dir;
+    const TCHAR *target;
+    split_argv(argv[0], &dir, NULL, &target, NULL);
+    if (!target)
+        target = invocation.target = _T(DEFAULT_TARGET);
+    TCHAR *arch = _tcsdup(target);
+    TCHAR *dash = _tcschr(arch, '-');
+    if (dash)
+        *dash = '\0';
+    TCHAR *target_os = _tcsrchr(target, '-');
+    if (target_os)
+        target_os++;
+
+    // If changing this table, change ld-wrapper.sh accordingly.
+    static const struct {
+        const TCHAR *arch;
+        const TCHAR *emulation;
+    } emulations[] = {
+        { _T("i686"),    _T("i386pe") },
+        { _T("x86_64"),  _T("i386pep") },
+        { _T("armv7"),   _T("thumb2pe") },
+        { _T("aarch64"), _T("arm64pe") },
+        { _T("arm64ec"), _T("arm64ecpe") },
+    };
+    const TCHAR *emulation = NULL;
+    for (size_t i = 0; i < sizeof(emulations)/sizeof(emulations[0]); i++) {
+        if (!_tcscmp(arch, emulations[i].arch)) {
+            emulation = emulations[i].emulation;
+            break;
+        }
+    }
+
+    int max_arg = argc + 8;
+    const TCHAR **exec_argv = malloc((max_arg + 1) * sizeof(*exec_argv));
+    int arg = 0;
+    exec_argv[arg++] = concat(dir, concat(_T("ld.lld"), EXE_SUFFIX));
+    if (emulation) {
+        exec_argv[arg++] = _T("-m");
+        exec_argv[arg++] = emulation;
+    }
+    if (target_os && !_tcscmp(target_os, _T("mingw32uwp"))) {
+        exec_argv[arg++] = _T("-lwindowsapp");
+        exec_argv[arg++] = _T("-lucrtapp");
+    }
+
+    // If a distributor is configured, run the ThinLTO backends as separate
+    // processes. Otherwise, if running under a parallel make, use as many
+    // threads as there are free job slots, instead of all cores.
+    const TCHAR *distributor = thinlto_distributor(dir);
+    if (distributor) {
+        exec_argv[arg++] = concat(_T("--thinlto-distributor="), distributor);
+        exec_argv[arg++] = concat(_T("--thinlto-remote-compiler="), concat(dir, concat(_T(CLANG), EXE_SUFFIX)));
+    } else {
+        int jobs = jobserver_acquire();
+        if (jobs > 0) {
+            exec_argv[arg++] = concat_int(_T("--threads="), jobs);
+            exec_argv[arg++] = concat_int(_T("--thinlto-jobs="), jobs);
+        }
+    }
+
+    // Let ThinLTO links reuse the backend outputs for unchanged modules, if
+    // a cache directory is configured.
+    const TCHAR *cache_dir = thinlto_cache_dir();
+    if (cache_dir) {
+        exec_argv[arg++] = concat(_T("--thinlto-cache-dir="), cache_dir);
+        const TCHAR *policy = _tgetenv(_T("LLVM_MINGW_THINLTO_CACHE_POLICY"));
+        if (policy && *policy)
+            exec_argv[arg++] = concat(_T("--thinlto-cache-policy="), policy);
+    }
+
+    for (int i = 1; i < argc; i++)
+        exec_argv[arg++] = argv[i];
+
+    exec_argv[arg] = NULL;
+    if (arg > max_arg) {
+        fprintf(stderr, "Too many options added\n");
+        abort();
+    }
+
+    return run_final(exec_argv[0], exec_argv);
+}
@@ -35,6 +35,9 @@ if [ "$TARGET" = "$BASENAME" ]; then
 fi
 ARCH="${TARGET%%-*}"
 TARGET_OS="${TARGET##*-}"
+# If changing this wrapper, change ld-wrapper.c accordingly.
+# The LLVM_MINGW_THINLTO_* options and the jobserver handling are only
+# implemented in ld-wrapper.c.
 case $ARCH in
 i686)    M=i386pe    ;;
 x86_64)  M=i386pep   ;;
@@ -29,10 +29,22 @@
 #define WIN32_LEAN_AND_MEAN
 #include <tchar.h>
 #include <windows.h>
+#include <direct.h>
 #include <process.h>
+#include <psapi.h>
 #define EXECVP_CAST
 #else
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
 typedef char TCHAR;
 #define _T(x) x
 #define _tcsrchr strrchr
@@ -42,15 +54,29 @@ typedef char TCHAR;
 #define _tcslen strlen
 #define _tcscmp strcmp
 #define _tcsncmp strncmp
+#define _tcscspn strcspn
 #define _tperror perror
 #define _texecvp execvp
 #define _tmain main
 #define _ftprintf fprintf
 #define _vftprintf vfprintf
 #define _tunlink unlink
+#define _tfopen fopen
+#define _fgetts fgets
+#define _tgetenv getenv
+#define _tputenv putenv
+#define _tmkdir(path) mkdir(path, 0777)
 #define EXECVP_CAST (char **)
 #endif
 
+#ifdef _WIN32
+#define PATH_SEP _T(";")
+#define EXE_SUFFIX _T(".exe")
+#else
+#define PATH_SEP _T(":")
+#define EXE_SUFFIX _T("")
+#endif
+
 #ifdef _UNICODE
 #define TS "%ls"
 #else
@@ -110,7 +136,10 @@ static TCHAR *make_response_file(const TCHAR **argv) {
     return rsp_file;
 }
 
-static inline int _tspawnvp_escape(int mode, const TCHAR *filename, const TCHAR * const *argv) {
+// Escape all arguments for a Windows command line. If the resulting
+// command line gets close to the length limit, the arguments are written
+// to a temporary response file instead, which the caller should delete.
+static inline const TCHAR **escape_argv(const TCHAR * const *argv, int *total_ptr, const TCHAR **temp_file_ptr) {
     int num_args = 0;
     while (argv[num_args])
         num_args++;
@@ -129,11 +158,11 @@ static inline int _tspawnvp_escape(int mode, const TCHAR *filename, const TCHAR
         if (temp_file)
             total = _tcslen(escaped_argv[0]) + _tcslen(escaped_argv[1]) + 2;
     }
-    int ret = _tspawnvp(mode, filename, escaped_argv);
-    if (temp_file)
-        DeleteFile(temp_file);
-    return ret;
+    *total_ptr = total;
+    *temp_file_ptr = temp_file;
+    return escaped_argv;
 }
+
 #else
 static inline int _tcsicmp(const TCHAR *a, const TCHAR *b) {
     while (*a && tolower(*a) == tolower(*b)) {
@@ -165,14 +194,65 @@ static inline TCHAR *_tcsrchrs(const TCHAR *str, TCHAR char1, TCHAR char2) {
     return ptr1;
 }
 
+// Details about the current invocation, for LLVM_MINGW_LOG. Filled in
+// by split_argv; wrappers that fall back to a default target set it
+// explicitly.
+static struct {
+    const TCHAR *tool;
+    const TCHAR *target;
+    const TCHAR *exe;
+} invocation;
+
+#ifndef _WIN32
+// Find the path of the running executable, with any symlinks resolved.
+// The wrappers are normally invoked through symlinks (possibly located in
+// a different directory), or found through PATH, but need to locate the
+// tools that are installed next to the actual wrapper executable.
+//
+// On Linux, the returned string is a static buffer, overwritten on the
+// next call; this is only meant to be called once, from split_argv.
+static inline char *get_executable_path(const char *argv0) {
+#if defined(__linux__)
+    static char buf[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+    if (len > 0) {
+        buf[len] = '\0';
+        return buf;
+    }
+#elif defined(__APPLE__)
+    char buf[PATH_MAX];
+    uint32_t size = sizeof(buf);
+    if (_NSGetExecutablePath(buf, &size) == 0)
+        return realpath(buf, NULL);
+#endif
+    if (strchr(argv0, '/'))
+        return realpath(argv0, NULL);
+    const char *path = getenv("PATH");
+    while (path && *path) {
+        const char *end = strchr(path, ':');
+        size_t len = end ? (size_t)(end - path) : strlen(path);
+        char candidate[PATH_MAX];
+        if (len > 0 && len + 1 + strlen(argv0) < sizeof(candidate)) {
+            memcpy(candidate, path, len);
+            candidate[len] = '/';
+            strcpy(candidate + len + 1, argv0);
+            if (access(candidate, X_OK) == 0)
+                return realpath(candidate, NULL);
+        }
+        path = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+#endif
+
 static inline void split_argv(const TCHAR *argv0, const TCHAR **dir_ptr, const TCHAR **basename_ptr, const TCHAR **target_ptr, const TCHAR **exe_ptr) {
+    const TCHAR *dir_src = argv0;
+    size_t dir_len = 0;
+    const TCHAR *basename_src = argv0;
     const TCHAR *sep = _tcsrchrs(argv0, '/', '\\');
-    TCHAR *dir = _tcsdup(_T(""));
-    const TCHAR *basename = argv0;
     if (sep) {
-        dir = _tcsdup(argv0);
-        dir[sep + 1 - argv0] = '\0';
-        basename = sep + 1;
+        dir_len = sep + 1 - argv0;
+        basename_src = sep + 1;
     }
 #ifdef _WIN32
     TCHAR module_path[8192];
@@ -189,19 +269,49 @@ static inline void split_argv(const TCHAR *argv0, const TCHAR **dir_ptr, const T
     if (long_path_ret > 0 && long_path_ret < sizeof(long_path)/sizeof(long_path[0])) {
         sep = _tcsrchrs(long_path, '/', '\\');
         if (sep)
-            basename = _tcsdup(sep + 1);
+            basename_src = sep + 1;
     }
     TCHAR *sep2 = _tcsrchr(module_path, '\\');
     if (sep2) {
-        sep2[1] = '\0';
-        dir = _tcsdup(module_path);
+        dir_src = module_path;
+        dir_len = sep2 + 1 - module_path;
+    }
+#else
+    char *exe_path = get_executable_path(argv0);
+    if (exe_path) {
+        const char *sep2 = strrchr(exe_path, '/');
+        if (sep2) {
+            dir_src = exe_path;
+            dir_len = sep2 + 1 - exe_path;
+        }
     }
 #endif
-    basename = _tcsdup(basename);
-    TCHAR *period = _tcschr(basename, '.');
+    size_t basename_len = _tcslen(basename_src);
+    const TCHAR *period = _tcschr(basename_src, '.');
     if (period)
-        *period = '\0';
-    TCHAR *target = _tcsdup(basename);
+        basename_len = period - basename_src;
+
+    // Copy all the parts into one buffer, laid out as
+    // "<dir>\0<basename>\0<target>\0", instead of duplicating each of them
+    // separately. This runs on every single tool invocation, so avoid
+    // allocating anything unless the path is unusually long.
+    //
+    // The buffer is static, so this isn't reentrant; each wrapper only
+    // calls this once, for its own argv[0]. A second call would overwrite
+    // the strings returned by the first one.
+    static TCHAR static_buf[8192];
+    size_t needed = dir_len + 1 + 2 * (basename_len + 1);
+    TCHAR *dir = static_buf;
+    if (needed > sizeof(static_buf)/sizeof(static_buf[0]))
+        dir = malloc(needed * sizeof(*dir));
+    memcpy(dir, dir_src, dir_len * sizeof(*dir));
+    dir[dir_len] = '\0';
+    TCHAR *basename = dir + dir_len + 1;
+    memcpy(basename, basename_src, basename_len * sizeof(*basename));
+    basename[basename_len] = '\0';
+    TCHAR *target = basename + basename_len + 1;
+    memcpy(target, basename, (basename_len + 1) * sizeof(*target));
+
     TCHAR *dash = _tcsrchr(target, '-');
     const TCHAR *exe = basename;
     if (dash) {
@@ -234,17 +344,488 @@ static inline void split_argv(const TCHAR *argv0, const TCHAR **dir_ptr, const T
         *target_ptr = target;
     if (exe_ptr)
         *exe_ptr = exe;
+
+    invocation.tool = basename;
+    invocation.target = target;
+    invocation.exe = exe;
+}
+
+// Get the root directory of the toolchain, given the directory of the
+// wrapper as returned by split_argv, i.e. <root>/bin/ without the
+// trailing "bin/" and separator. Returns NULL if the wrapper isn't located
+// in a directory named bin.
+static inline TCHAR *toolchain_root(const TCHAR *dir) {
+    size_t len = _tcslen(dir);
+    if (len < 5 || _tcsncmp(dir + len - 4, _T("bin"), 3) ||
+        (dir[len - 5] != '/' && dir[len - 5] != '\\'))
+        return NULL;
+    TCHAR *root = _tcsdup(dir);
+    root[len - 5] = '\0';
+    // Keep the separator if the root is the root of a file system.
+    if (!root[0] || (len == 7 && root[1] == ':'))
+        root[len - 5] = dir[len - 5];
+    return root;
+}
+
+// Create a directory along with any missing parent directories, like
+// mkdir -p. Errors are ignored; they show up when using the directory.
+static inline void make_dirs(const TCHAR *path) {
+    TCHAR *buf = _tcsdup(path);
+    for (TCHAR *p = buf + 1; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            TCHAR sep = *p;
+            *p = '\0';
+            _tmkdir(buf);
+            *p = sep;
+        }
+    }
+    _tmkdir(buf);
+    free(buf);
+}
+
+// Look up a tool name (the part after the last dash, e.g. "clang++" in
+// x86_64-w64-mingw32-clang++) among the compiler frontends that
+// clang-target-wrapper handles. Returns nonzero if it is a known compiler
+// name, and optionally returns the extra option that the name implies.
+//
+// If changing this list, change clang-target-wrapper.sh accordingly.
+static inline int lookup_compiler_exe(const TCHAR *exe, const TCHAR **flag_ptr) {
+    static const struct {
+        const TCHAR *exe;
+        const TCHAR *flag;
+    } compiler_exes[] = {
+        { _T("clang"),   NULL },
+        { _T("clang++"), _T("--driver-mode=g++") },
+        { _T("gcc"),     NULL },
+        { _T("g++"),     _T("--driver-mode=g++") },
+        { _T("c++"),     _T("--driver-mode=g++") },
+        { _T("as"),      NULL },
+        { _T("cc"),      NULL },
+        { _T("c99"),     _T("-std=c99") },
+        { _T("c11"),     _T("-std=c11") },
+    };
+    for (size_t i = 0; i < sizeof(compiler_exes)/sizeof(compiler_exes[0]); i++) {
+        if (!_tcscmp(exe, compiler_exes[i].exe)) {
+            if (flag_ptr)
+                *flag_ptr = compiler_exes[i].flag;
+            return 1;
+        }
+    }
+    if (flag_ptr)
+        *flag_ptr = NULL;
+    return 0;
 }
 
-static inline int run_final(const TCHAR *executable, const TCHAR *const *argv) {
 #ifdef _WIN32
-    int ret = _tspawnvp_escape(_P_WAIT, executable, argv);
-    if (ret == -1) {
-        _tperror(executable);
+// Start an executable, returning the process handle, or NULL on failure.
+//
+// If given a full path to the executable, use CreateProcess directly.
+// Compared to _tspawnvp, this avoids probing for the executable with
+// a number of different file extensions, and copying the whole
+// environment into a new environment block, on every invocation.
+// Only do a search through the path (e.g. for ccache) otherwise.
+static inline HANDLE start_process(const TCHAR *executable, const TCHAR *const *argv, const TCHAR **temp_file_ptr) {
+    int total;
+    const TCHAR **escaped_argv = escape_argv(argv, &total, temp_file_ptr);
+    const TCHAR *sep = _tcsrchrs(executable, '/', '\\');
+    if (!sep) {
+        intptr_t ret = _tspawnvp(_P_NOWAIT, executable, escaped_argv);
+        if (ret == -1) {
+            _tperror(executable);
+            return NULL;
+        }
+        return (HANDLE) ret;
+    }
+    // CreateProcess doesn't add the extension for us. Only look at the
+    // suffix; tool names like ld.lld contain a dot too.
+    size_t len = _tcslen(executable);
+    if (len < 4 || _tcsicmp(executable + len - 4, _T(".exe")))
+        executable = concat(executable, _T(".exe"));
+
+    TCHAR *cmdline = malloc((total + 1) * sizeof(*cmdline));
+    TCHAR *ptr = cmdline;
+    for (int i = 0; escaped_argv[i]; i++) {
+        if (i > 0)
+            *ptr++ = ' ';
+        _tcscpy(ptr, escaped_argv[i]);
+        ptr += _tcslen(ptr);
+    }
+    *ptr = '\0';
+
+    STARTUPINFO si;
+    PROCESS_INFORMATION pi;
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    if (!CreateProcess(executable, cmdline, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi)) {
+        _ftprintf(stderr, _T(TS": Unable to execute (error %lu)\n"), executable, GetLastError());
+        return NULL;
+    }
+    CloseHandle(pi.hThread);
+    return pi.hProcess;
+}
+
+static inline unsigned long long filetime_us(FILETIME ft) {
+    return ((((unsigned long long) ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 10;
+}
+#endif
+
+// A minimal GNU make jobserver client. When invoked from a parallel make,
+// a wrapper can take extra job slots (beyond the one that make implicitly
+// gave us for running this command), to let multithreaded tools like lld
+// use that many threads, without oversubscribing the machine. The tokens
+// are given back when the child process has finished.
+static struct {
+    int tokens;
+#ifdef _WIN32
+    HANDLE sem;
+#else
+    int read_fd, write_fd;
+    char token_chars[256];
+#endif
+} jobserver;
+
+static inline int num_cpus(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+#endif
+}
+
+#ifndef _WIN32
+static inline int is_fifo(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+#endif
+
+static inline int jobserver_open(void) {
+    const char *makeflags = getenv("MAKEFLAGS");
+    if (!makeflags)
+        return 0;
+    // Pick the last occurrence of the option; older versions of make
+    // used --jobserver-fds instead of --jobserver-auth.
+    const char *auth = NULL;
+    for (const char *ptr = makeflags; (ptr = strstr(ptr, "--jobserver-")); ptr++) {
+        if (!strncmp(ptr, "--jobserver-auth=", 17))
+            auth = ptr + 17;
+        else if (!strncmp(ptr, "--jobserver-fds=", 16))
+            auth = ptr + 16;
+    }
+    if (!auth)
+        return 0;
+    char value[1024];
+    size_t len = strcspn(auth, " ");
+    if (len == 0 || len >= sizeof(value))
+        return 0;
+    memcpy(value, auth, len);
+    value[len] = '\0';
+#ifdef _WIN32
+    // A named semaphore. Don't let the processes we start inherit the
+    // handle; they run within the job slots that we have taken.
+    jobserver.sem = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, value);
+    return jobserver.sem != NULL;
+#else
+    if (!strncmp(value, "fifo:", 5)) {
+        // Open our own nonblocking handle to the fifo, so that we can
+        // poll for tokens without affecting other clients. Like for the
+        // inherited fds below, don't pass it on to the processes we start.
+        jobserver.read_fd = open(value + 5, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (jobserver.read_fd < 0)
+            return 0;
+        if (!is_fifo(jobserver.read_fd)) {
+            close(jobserver.read_fd);
+            return 0;
+        }
+        jobserver.write_fd = open(value + 5, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (jobserver.write_fd < 0) {
+            close(jobserver.read_fd);
+            return 0;
+        }
         return 1;
     }
-    return ret;
+    int read_fd, write_fd;
+    if (sscanf(value, "%d,%d", &read_fd, &write_fd) != 2 || read_fd < 0 || write_fd < 0)
+        return 0;
+    // Make closes the jobserver fds for commands that it doesn't consider
+    // to be recursive make invocations, so the fd numbers may have been
+    // reused for something else; only trust them if both are pipes.
+    if (!is_fifo(read_fd) || !is_fifo(write_fd))
+        return 0;
+    // The processes we start run within the job slots that we have taken;
+    // don't let them inherit the fds and take more slots on their own.
+    // (This only affects our own fd table, not other users of the pipe.)
+    fcntl(read_fd, F_SETFD, fcntl(read_fd, F_GETFD) | FD_CLOEXEC);
+    fcntl(write_fd, F_SETFD, fcntl(write_fd, F_GETFD) | FD_CLOEXEC);
+#ifdef __linux__
+    // We can't set O_NONBLOCK on the inherited pipe without affecting all
+    // other processes sharing it; reopen it instead.
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", read_fd);
+    jobserver.read_fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (jobserver.read_fd < 0)
+        return 0;
+    jobserver.write_fd = write_fd;
+    return 1;
 #else
+    // Without a way to read without blocking, don't try to take any tokens.
+    return 0;
+#endif
+#endif
+}
+
+// Take as many extra job slots as are available without waiting, up to
+// the number of CPUs. Returns the total number of jobs we can run,
+// including the implicit slot, or 0 if not running under a jobserver.
+static inline int jobserver_acquire(void) {
+    if (!jobserver_open())
+        return 0;
+    int max = num_cpus() - 1;
+#ifndef _WIN32
+    if (max > (int) sizeof(jobserver.token_chars))
+        max = sizeof(jobserver.token_chars);
+#endif
+    while (jobserver.tokens < max) {
+#ifdef _WIN32
+        if (WaitForSingleObject(jobserver.sem, 0) != WAIT_OBJECT_0)
+            break;
+#else
+        if (read(jobserver.read_fd, &jobserver.token_chars[jobserver.tokens], 1) != 1)
+            break;
+#endif
+        jobserver.tokens++;
+    }
+    return 1 + jobserver.tokens;
+}
+
+static inline void jobserver_release(void) {
+    if (!jobserver.tokens)
+        return;
+#ifdef _WIN32
+    ReleaseSemaphore(jobserver.sem, jobserver.tokens, NULL);
+#else
+    while (write(jobserver.write_fd, jobserver.token_chars, jobserver.tokens) < 0 && errno == EINTR)
+        ;
+#endif
+    jobserver.tokens = 0;
+}
+
+static inline TCHAR *concat_int(const TCHAR *prefix, int value) {
+    TCHAR buf[16];
+    TCHAR *ptr = buf + sizeof(buf)/sizeof(buf[0]) - 1;
+    *ptr = '\0';
+    do {
+        *--ptr = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    return concat(prefix, ptr);
+}
+
+// Get the ThinLTO cache directory to use for links, from
+// LLVM_MINGW_THINLTO_CACHE. A relative path is taken relative to
+// LLVM_MINGW_BASEDIR if set (giving one cache per project), otherwise
+// relative to the current directory. Returns NULL if not set.
+static inline const TCHAR *thinlto_cache_dir(void) {
+    const TCHAR *cache = _tgetenv(_T("LLVM_MINGW_THINLTO_CACHE"));
+    if (!cache || !*cache)
+        return NULL;
+    const TCHAR *basedir = _tgetenv(_T("LLVM_MINGW_BASEDIR"));
+    int absolute = cache[0] == '/' || cache[0] == '\\' || (cache[0] && cache[1] == ':');
+    if (absolute || !basedir || !*basedir)
+        return cache;
+    return concat(basedir, concat(_T("/"), cache));
+}
+
+// Get the distributor to use for distributed ThinLTO, from
+// LLVM_MINGW_THINLTO_DISTRIBUTOR; "local" picks the bundled
+// thinlto-local-distributor, which runs the backend compilations as
+// local processes. Returns NULL if not set.
+static inline const TCHAR *thinlto_distributor(const TCHAR *dir) {
+    const TCHAR *distributor = _tgetenv(_T("LLVM_MINGW_THINLTO_DISTRIBUTOR"));
+    if (!distributor || !*distributor)
+        return NULL;
+    if (!_tcscmp(distributor, _T("local")))
+        return concat(dir, concat(_T("thinlto-local-distributor"), EXE_SUFFIX));
+    return distributor;
+}
+
+// Append a string to a JSON record, converting to UTF-8 if necessary.
+static inline char *log_append(char *ptr, char *end, const TCHAR *str) {
+    if (!str)
+        str = _T("");
+#ifdef _UNICODE
+    char buf[1024];
+    if (!WideCharToMultiByte(CP_UTF8, 0, str, -1, buf, sizeof(buf), NULL, NULL))
+        buf[0] = '\0';
+    const char *in = buf;
+#else
+    const char *in = str;
+#endif
+    while (*in && ptr < end - 2) {
+        if (*in == '"' || *in == '\\')
+            *ptr++ = '\\';
+        *ptr++ = *in++;
+    }
+    *ptr = '\0';
+    return ptr;
+}
+
+// Append one JSON record, describing a finished tool invocation, to the
+// file named by LLVM_MINGW_LOG. Times are in microseconds, the start time
+// relative to the unix epoch.
+static inline void log_invocation(const TCHAR *log_file, const TCHAR *const *argv,
+                                  unsigned long long start, unsigned long long wall,
+                                  unsigned long long user, unsigned long long sys,
+                                  unsigned long long maxrss, int exit_code) {
+    int num_args = 0;
+    while (argv[num_args])
+        num_args++;
+    const TCHAR *target = invocation.target;
+    TCHAR arch[64] = _T("");
+    if (target) {
+        size_t len = _tcscspn(target, _T("-"));
+        if (len >= sizeof(arch)/sizeof(arch[0]))
+            len = sizeof(arch)/sizeof(arch[0]) - 1;
+        memcpy(arch, target, len * sizeof(*arch));
+        arch[len] = '\0';
+    }
+
+    char buf[4096];
+    char *end = buf + sizeof(buf) - 256;
+    char *ptr = buf;
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = getpid();
+#endif
+    ptr += sprintf(ptr, "{\"ts\":%llu,\"dur\":%llu,\"pid\":%lu,\"tool\":\"", start, wall, pid);
+    ptr = log_append(ptr, end, invocation.tool);
+    ptr += sprintf(ptr, "\",\"target\":\"");
+    ptr = log_append(ptr, end, target);
+    ptr += sprintf(ptr, "\",\"arch\":\"");
+    ptr = log_append(ptr, end, arch);
+    ptr += sprintf(ptr, "\",\"exe\":\"");
+    ptr = log_append(ptr, end, invocation.exe);
+    ptr += sprintf(ptr, "\",\"argc\":%d,\"user\":%llu,\"sys\":%llu,\"maxrss\":%llu,\"exit\":%d}\n",
+                   num_args, user, sys, maxrss, exit_code);
+
+    // Write the whole record with one single write to a file opened in
+    // append mode, to avoid interleaving records from concurrent processes.
+#ifdef _WIN32
+    HANDLE h = CreateFile(log_file, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                          NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+    DWORD written;
+    WriteFile(h, buf, ptr - buf, &written, NULL);
+    CloseHandle(h);
+#else
+    int fd = open(log_file, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    if (fd < 0)
+        return;
+    if (write(fd, buf, ptr - buf) < 0) {
+        // Ignore failures; logging is best effort.
+    }
+    close(fd);
+#endif
+}
+
+// Run an executable as a child process and wait for it to finish, logging
+// it if LLVM_MINGW_LOG is set. Returns its exit code.
+static inline int run_child(const TCHAR *executable, const TCHAR *const *argv) {
+    const TCHAR *log_file = _tgetenv(_T("LLVM_MINGW_LOG"));
+    if (log_file && !*log_file)
+        log_file = NULL;
+#ifdef _WIN32
+    FILETIME start;
+    GetSystemTimeAsFileTime(&start);
+    const TCHAR *temp_file;
+    HANDLE process = start_process(executable, argv, &temp_file);
+    if (!process) {
+        jobserver_release();
+        if (temp_file)
+            DeleteFile(temp_file);
+        return 1;
+    }
+    WaitForSingleObject(process, INFINITE);
+    jobserver_release();
+    DWORD exit_code = 1;
+    GetExitCodeProcess(process, &exit_code);
+    if (log_file) {
+        FILETIME end, creation_time, exit_time, kernel_time, user_time;
+        GetSystemTimeAsFileTime(&end);
+        unsigned long long user_us = 0, sys_us = 0, maxrss = 0;
+        if (GetProcessTimes(process, &creation_time, &exit_time, &kernel_time, &user_time)) {
+            user_us = filetime_us(user_time);
+            sys_us = filetime_us(kernel_time);
+        }
+        PROCESS_MEMORY_COUNTERS pmc;
+        if (K32GetProcessMemoryInfo(process, &pmc, sizeof(pmc)))
+            maxrss = pmc.PeakWorkingSetSize;
+        // FILETIME counts 100 ns intervals since 1601.
+        unsigned long long start_us = filetime_us(start) - 11644473600000000ULL;
+        log_invocation(log_file, argv, start_us, filetime_us(end) - filetime_us(start),
+                       user_us, sys_us, maxrss, exit_code);
+    }
+    CloseHandle(process);
+    if (temp_file)
+        DeleteFile(temp_file);
+    return exit_code;
+#else
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        jobserver_release();
+        return 1;
+    }
+    if (pid == 0) {
+        _texecvp(executable, EXECVP_CAST argv);
+        _tperror(executable);
+        _exit(127);
+    }
+    int status;
+    struct rusage ru;
+    while (wait4(pid, &status, 0, &ru) < 0) {
+        if (errno != EINTR) {
+            perror("wait4");
+            jobserver_release();
+            return 1;
+        }
+    }
+    gettimeofday(&end, NULL);
+    jobserver_release();
+    int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    unsigned long long maxrss = ru.ru_maxrss;
+#ifndef __APPLE__
+    // ru_maxrss is in bytes on macOS, but in KB elsewhere.
+    maxrss *= 1024;
+#endif
+    unsigned long long start_us = start.tv_sec * 1000000ULL + start.tv_usec;
+    unsigned long long end_us = end.tv_sec * 1000000ULL + end.tv_usec;
+    if (log_file)
+        log_invocation(log_file, argv, start_us, end_us - start_us,
+                       ru.ru_utime.tv_sec * 1000000ULL + ru.ru_utime.tv_usec,
+                       ru.ru_stime.tv_sec * 1000000ULL + ru.ru_stime.tv_usec,
+                       maxrss, exit_code);
+    return exit_code;
+#endif
+}
+
+static inline int run_final(const TCHAR *executable, const TCHAR *const *argv) {
+#ifndef _WIN32
+    const TCHAR *log_file = _tgetenv(_T("LLVM_MINGW_LOG"));
+    if ((log_file && *log_file) || jobserver.tokens) {
+        // To be able to log the resource usage of the child, or to return
+        // jobserver tokens once it has finished, we need to run it as a
+        // separate process, instead of replacing ourselves.
+        return run_child(executable, argv);
+    }
+
     // On unix, exec() runs the target executable within this same process,
     // making the return code propagate implicitly.
     // Windows doesn't have such mechanisms, and the exec() family of functions
@@ -255,5 +836,7 @@ static inline int run_final(const TCHAR *executable, const TCHAR *const *argv) {
 
     _tperror(executable);
     return 1;
+#else
+    return run_child(executable, argv);
 #endif
 }
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2026 Martin Storsjo
+ *
+ * This file is part of llvm-mingw.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "native-wrapper.h"
+
+// libtool can try to run objdump -f and wants to see certain strings in
+// the output, to accept it being a windows (import) library. Produce the
+// same output as objdump-wrapper.sh does (based on the format names that
+// llvm-readobj prints), by inspecting the file headers directly, instead
+// of running llvm-readobj and postprocessing its output. Anything else
+// (e.g. ELF files) is left to llvm-objdump -f.
+
+static const unsigned char bigobj_magic[16] = {
+    0xc7, 0xa1, 0xba, 0xd1, 0xee, 0xba, 0xa9, 0x4b,
+    0xaf, 0x20, 0xfa, 0xf6, 0x6a, 0xa4, 0xdc, 0xb8,
+};
+
+static unsigned read16(const unsigned char *ptr) {
+    return ptr[0] | (ptr[1] << 8);
+}
+
+static unsigned long read32(const unsigned char *ptr) {
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((unsigned long)ptr[3] << 24);
+}
+
+static int read_at(FILE *f, long offset, unsigned char *buf, size_t len) {
+    if (fseek(f, offset, SEEK_SET))
+        return 0;
+    return fread(buf, 1, len, f) == len;
+}
+
+static const char *machine_name(unsigned machine) {
+    switch (machine) {
+    case 0x14c:  return "i386";
+    case 0x8664: return "x86-64";
+    case 0x1c4:  return "ARM";
+    case 0xaa64: return "ARM64";
+    case 0xa641: return "ARM64EC";
+    case 0xa64e: return "ARM64X";
+    }
+    return NULL;
+}
+
+// Identify the object (or executable) located at offset in f. Returns
+// 1 for regular objects, 2 for short import library members and 0 for
+// unrecognized files. For recognized files, the format name, as printed
+// by llvm-readobj, is written into format.
+static int identify(FILE *f, long offset, char *format, size_t format_size) {
+    // Short import members can be smaller than the buffer; zero fill
+    // whatever we didn't get.
+    unsigned char buf[64];
+    memset(buf, 0, sizeof(buf));
+    if (fseek(f, offset, SEEK_SET) || fread(buf, 1, sizeof(buf), f) < 20)
+        return 0;
+    unsigned machine;
+    int type = 1;
+    if (buf[0] == 'M' && buf[1] == 'Z') {
+        unsigned char pe[6];
+        if (!read_at(f, offset + read32(buf + 0x3c), pe, sizeof(pe)) ||
+            memcmp(pe, "PE\0\0", 4))
+            return 0;
+        machine = read16(pe + 4);
+    } else if (read16(buf) == 0 && read16(buf + 2) == 0xffff) {
+        if (read16(buf + 4) == 0)
+            type = 2;
+        else if (read16(buf + 4) < 2 || memcmp(buf + 12, bigobj_magic, sizeof(bigobj_magic)))
+            return 0;
+        machine = read16(buf + 6);
+    } else {
+        machine = read16(buf);
+        if (!machine_name(machine))
+            return 0;
+    }
+    const char *name = machine_name(machine);
+    snprintf(format, format_size, "COFF-%s%s", type == 2 ? "import-file-" : "",
+             name ? name : "<unknown arch>");
+    return type;
+}
+
+static const char *map_format(const char *format) {
+    if (!strcmp(format, "COFF-i386"))
+        return "pe-i386";
+    if (!strcmp(format, "COFF-x86-64"))
+        return "pe-x86-64";
+    if (!strncmp(format, "COFF-ARM", 8)) {
+        // This is wrong; modern COFF armv7 isn't pe-arm-wince, and
+        // arm64 definitely isn't, but libtool wants to see this
+        // string (or some of the others) in order to accept it.
+        return "pe-arm-wince";
+    }
+    return format;
+}
+
+static void print_format(const TCHAR *file, const char *member, const char *format) {
+    _ftprintf(stdout, _T(TS), file);
+    if (member) {
+        // Member names are plain ASCII in practice; print them byte by byte
+        // to avoid needing to convert them into TCHAR strings.
+        putchar('(');
+        for (const char *ptr = member; *ptr; ptr++)
+            putchar(*ptr);
+        putchar(')');
+    }
+    fputs(": file format ", stdout);
+    fputs(map_format(format), stdout);
+    putchar('\n');
+}
+
+static void print_member(const char *member, const char *format) {
+    fputs(member, stdout);
+    fputs(": file format ", stdout);
+    fputs(map_format(format), stdout);
+    putchar('\n');
+}
+
+static int is_bitcode(FILE *f, long offset) {
+    unsigned char magic[4];
+    return read_at(f, offset, magic, sizeof(magic)) && !memcmp(magic, "BC\xc0\xde", 4);
+}
+
+// Print the format of the members of an archive, or if print is zero,
+// only check that all members are recognized. Returns -1 if some member
+// isn't a COFF object (or LLVM bitcode, which has no format to print).
+static int dump_archive(const TCHAR *file, FILE *f, int print) {
+    char *long_names = NULL;
+    size_t long_names_size = 0;
+    long offset = 8;
+    unsigned char header[60];
+    while (read_at(f, offset, header, sizeof(header))) {
+        if (header[58] != '`' || header[59] != '\n')
+            return 1;
+        char size_str[11];
+        memcpy(size_str, header + 48, 10);
+        size_str[10] = '\0';
+        long size = strtol(size_str, NULL, 10);
+        long data = offset + sizeof(header);
+        offset = data + size + (size & 1);
+
+        char name[256];
+        if (header[0] == '/') {
+            if (header[1] == '/' && header[2] == ' ') {
+                // The long name table
+                free(long_names);
+                long_names = malloc(size + 1);
+                if (!long_names || !read_at(f, data, (unsigned char *)long_names, size))
+                    return 1;
+                long_names[size] = '\0';
+                long_names_size = size;
+                continue;
+            }
+            if (header[1] < '0' || header[1] > '9') {
+                // The symbol tables; "/", "/SYM64/", "/<ECSYMBOLS>/"
+                continue;
+            }
+            size_t name_offset = strtoul((const char *)header + 1, NULL, 10);
+            if (!long_names || name_offset >= long_names_size)
+                return 1;
+            size_t len = strcspn(long_names + name_offset, "/\n");
+            if (len >= sizeof(name))
+                len = sizeof(name) - 1;
+            memcpy(name, long_names + name_offset, len);
+            name[len] = '\0';
+        } else if (!memcmp(header, "#1/", 3)) {
+            // BSD style long names, stored at the start of the member data
+            size_t len = strtoul((const char *)header + 3, NULL, 10);
+            if (len >= sizeof(name) || !read_at(f, data, (unsigned char *)name, len))
+                return 1;
+            name[len] = '\0';
+            data += len;
+        } else {
+            size_t len = 0;
+            while (len < 16 && header[len] != '/' && header[len] != ' ')
+                len++;
+            memcpy(name, header, len);
+            name[len] = '\0';
+        }
+
+        char format[64];
+        switch (identify(f, data, format, sizeof(format))) {
+        case 1:
+            if (print)
+                print_format(file, name, format);
+            break;
+        case 2:
+            // llvm-readobj prints only the member name for short import
+            // library members.
+            if (print)
+                print_member(name, format);
+            break;
+        default:
+            if (!is_bitcode(f, data)) {
+                free(long_names);
+                return -1;
+            }
+            break;
+        }
+    }
+    free(long_names);
+    return 0;
+}
+
+// Print the format of a file, or if print is zero, only check whether
+// it is recognized. Returns -1 for files that aren't recognized (or can't
+// be read).
+static int dump_file(const TCHAR *file, int print) {
+    FILE *f = _tfopen(file, _T("rb"));
+    if (!f)
+        return -1;
+    unsigned char magic[8];
+    int ret = 0;
+    if (read_at(f, 0, magic, sizeof(magic)) && !memcmp(magic, "!<arch>\n", 8)) {
+        ret = dump_archive(file, f, print);
+    } else {
+        char format[64];
+        if (!identify(f, 0, format, sizeof(format)))
+            ret = -1;
+        else if (print)
+            print_format(file, NULL, format);
+    }
+    fclose(f);
+    return ret;
+}
+
+int _tmain(int argc, TCHAR* argv[]) {
+    const TCHAR *dir;
+    split_argv(argv[0], &dir, NULL, NULL, NULL);
+
+    if (argc >= 2 && !_tcscmp(argv[1], _T("-f"))) {
+        // Only handle the command ourselves if we recognize all the files;
+        // otherwise run llvm-objdump -f on them below (which also reports
+        // any errors).
+        int recognized = 1;
+        for (int i = 2; i < argc && recognized; i++)
+            if (argv[i][0] == '-' || dump_file(argv[i], 0) < 0)
+                recognized = 0;
+        if (recognized) {
+            int ret = 0;
+            for (int i = 2; i < argc; i++)
+                ret |= dump_file(argv[i], 1) < 0;
+            return ret;
+        }
+    }
+
+    const TCHAR **exec_argv = malloc((argc + 1) * sizeof(*exec_argv));
+    exec_argv[0] = concat(dir, _T("llvm-objdump"));
+    for (int i = 1; i < argc; i++)
+        exec_argv[i] = argv[i];
+    exec_argv[argc] = NULL;
+
+    return run_final(exec_argv[0], exec_argv);
+}
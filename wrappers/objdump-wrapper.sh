@@ -27,6 +27,7 @@ get_dir() {
 DIR="$(get_dir "$0")"
 export PATH="$DIR":"$PATH"
 
+# If changing this wrapper, change objdump-wrapper.c accordingly.
 if [ "$1" = "-f" ]; then
     # libtool can try to run objdump -f and wants to see certain strings in
     # the output, to accept it being a windows (import) library
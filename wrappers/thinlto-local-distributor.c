@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2026 Martin Storsjo
+ *
+ * This file is part of llvm-mingw.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "native-wrapper.h"
+
+// A distributor for distributed ThinLTO, which runs the backend
+// compilations as separate processes on the local machine. lld invokes
+// this with a JSON file describing the jobs as the last argument; each
+// job is run as the command line given by "common.args" followed by the
+// job's "args".
+//
+// The number of parallel jobs is taken from LLVM_MINGW_THINLTO_JOBS if
+// set, otherwise from the available make jobserver slots if running under
+// a parallel make, otherwise the number of CPUs.
+
+struct json {
+    enum { JSON_OTHER, JSON_STRING, JSON_ARRAY, JSON_OBJECT } type;
+    char *str;
+    int n;
+    char **keys;
+    struct json **items;
+};
+
+static const char *skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        p++;
+    return p;
+}
+
+static int hex_value(const char *p) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return value;
+}
+
+// Parse a JSON string, starting after the opening quote, into UTF-8.
+static char *parse_string(const char **pp) {
+    const char *p = *pp;
+    // The unescaped string is never longer than the escaped one.
+    char *out = malloc(strlen(p) + 1);
+    char *ptr = out;
+    while (*p && *p != '"') {
+        if (*p != '\\') {
+            *ptr++ = *p++;
+            continue;
+        }
+        p++;
+        switch (*p) {
+        case 'b': *ptr++ = '\b'; p++; break;
+        case 'f': *ptr++ = '\f'; p++; break;
+        case 'n': *ptr++ = '\n'; p++; break;
+        case 'r': *ptr++ = '\r'; p++; break;
+        case 't': *ptr++ = '\t'; p++; break;
+        case 'u': {
+            long c = hex_value(p + 1);
+            if (c < 0)
+                return NULL;
+            p += 5;
+            if (c >= 0xd800 && c < 0xdc00 && p[0] == '\\' && p[1] == 'u') {
+                long low = hex_value(p + 2);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                    p += 6;
+                }
+            }
+            if (c < 0x80) {
+                *ptr++ = c;
+            } else if (c < 0x800) {
+                *ptr++ = 0xc0 | (c >> 6);
+                *ptr++ = 0x80 | (c & 0x3f);
+            } else if (c < 0x10000) {
+                *ptr++ = 0xe0 | (c >> 12);
+                *ptr++ = 0x80 | ((c >> 6) & 0x3f);
+                *ptr++ = 0x80 | (c & 0x3f);
+            } else {
+                *ptr++ = 0xf0 | (c >> 18);
+                *ptr++ = 0x80 | ((c >> 12) & 0x3f);
+                *ptr++ = 0x80 | ((c >> 6) & 0x3f);
+                *ptr++ = 0x80 | (c & 0x3f);
+            }
+            break;
+        }
+        case '\0':
+            return NULL;
+        default:
+            // \", \\ and \/
+            *ptr++ = *p++;
+            break;
+        }
+    }
+    if (*p != '"')
+        return NULL;
+    *ptr = '\0';
+    *pp = p + 1;
+    return out;
+}
+
+static struct json *parse_value(const char **pp) {
+    const char *p = skip_ws(*pp);
+    struct json *value = calloc(1, sizeof(*value));
+    if (*p == '"') {
+        p++;
+        value->type = JSON_STRING;
+        value->str = parse_string(&p);
+        if (!value->str)
+            return NULL;
+    } else if (*p == '[' || *p == '{') {
+        int object = *p == '{';
+        char end = object ? '}' : ']';
+        value->type = object ? JSON_OBJECT : JSON_ARRAY;
+        p = skip_ws(p + 1);
+        int allocated = 0;
+        while (*p != end) {
+            if (value->n == allocated) {
+                allocated = allocated ? 2 * allocated : 8;
+                value->items = realloc(value->items, allocated * sizeof(*value->items));
+                value->keys = realloc(value->keys, allocated * sizeof(*value->keys));
+            }
+            value->keys[value->n] = NULL;
+            if (object) {
+                if (*p != '"')
+                    return NULL;
+                p++;
+                value->keys[value->n] = parse_string(&p);
+                p = skip_ws(p);
+                if (!value->keys[value->n] || *p != ':')
+                    return NULL;
+                p++;
+            }
+            value->items[value->n] = parse_value(&p);
+            if (!value->items[value->n])
+                return NULL;
+            value->n++;
+            p = skip_ws(p);
+            if (*p == ',')
+                p = skip_ws(p + 1);
+            else if (*p != end)
+                return NULL;
+        }
+        p++;
+    } else {
+        // Numbers, true, false and null; not used in any field we need.
+        value->type = JSON_OTHER;
+        while (*p && !strchr(",]} \t\r\n", *p))
+            p++;
+    }
+    *pp = p;
+    return value;
+}
+
+static struct json *get_field(const struct json *object, const char *key, int type) {
+    if (!object || object->type != JSON_OBJECT)
+        return NULL;
+    for (int i = 0; i < object->n; i++)
+        if (!strcmp(object->keys[i], key))
+            return (int) object->items[i]->type == type ? object->items[i] : NULL;
+    return NULL;
+}
+
+static const TCHAR *to_tchar(const char *str) {
+#ifdef _UNICODE
+    int len = MultiByteToWideChar(CP_UTF8, 0, str, -1, NULL, 0);
+    TCHAR *out = malloc(len * sizeof(*out));
+    MultiByteToWideChar(CP_UTF8, 0, str, -1, out, len);
+    return out;
+#else
+    return str;
+#endif
+}
+
+// Build the command line for one job, or return NULL if the job
+// description is malformed.
+static const TCHAR **job_argv(const struct json *common_args, const struct json *job) {
+    const struct json *args = get_field(job, "args", JSON_ARRAY);
+    if (!args)
+        return NULL;
+    const TCHAR **argv = malloc((common_args->n + args->n + 1) * sizeof(*argv));
+    int arg = 0;
+    for (int i = 0; i < common_args->n + args->n; i++) {
+        const struct json *item = i < common_args->n ? common_args->items[i] :
+                                                       args->items[i - common_args->n];
+        if (item->type != JSON_STRING)
+            return NULL;
+        argv[arg++] = to_tchar(item->str);
+    }
+    argv[arg] = NULL;
+    return arg > 0 ? argv : NULL;
+}
+
+static char *read_file(const TCHAR *path) {
+    FILE *f = _tfopen(path, _T("rb"));
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc(size + 1);
+    if (size < 0 || fread(buf, 1, size, f) != (size_t) size) {
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    buf[size] = '\0';
+    return buf;
+}
+
+int _tmain(int argc, TCHAR* argv[]) {
+    if (argc < 2) {
+        _ftprintf(stderr, _T(TS" <jobs.json>\n"), argv[0]);
+        return 1;
+    }
+    const TCHAR *json_file = argv[argc - 1];
+    char *buf = read_file(json_file);
+    if (!buf) {
+        _tperror(json_file);
+        return 1;
+    }
+    const char *p = buf;
+    struct json *root = parse_value(&p);
+    struct json *common_args = get_field(get_field(root, "common", JSON_OBJECT), "args", JSON_ARRAY);
+    struct json *jobs = get_field(root, "jobs", JSON_ARRAY);
+    if (!common_args || !jobs) {
+        _ftprintf(stderr, _T(TS": Malformed job description\n"), json_file);
+        return 1;
+    }
+
+    int max_jobs = 0;
+    const char *jobs_env = getenv("LLVM_MINGW_THINLTO_JOBS");
+    if (jobs_env)
+        max_jobs = atoi(jobs_env);
+    if (max_jobs <= 0)
+        max_jobs = jobserver_acquire();
+    if (max_jobs <= 0)
+        max_jobs = num_cpus();
+#ifdef _WIN32
+    if (max_jobs > MAXIMUM_WAIT_OBJECTS)
+        max_jobs = MAXIMUM_WAIT_OBJECTS;
+    HANDLE *processes = malloc(max_jobs * sizeof(*processes));
+    const TCHAR **temp_files = malloc(max_jobs * sizeof(*temp_files));
+#endif
+
+    int next = 0, running = 0, failed = 0;
+    while (running > 0 || (!failed && next < jobs->n)) {
+        while (!failed && running < max_jobs && next < jobs->n) {
+            const TCHAR **job = job_argv(common_args, jobs->items[next]);
+            if (!job) {
+                _ftprintf(stderr, _T(TS": Malformed job description\n"), json_file);
+                failed = 1;
+                break;
+            }
+            next++;
+#ifdef _WIN32
+            HANDLE process = start_process(job[0], job, &temp_files[running]);
+            if (!process) {
+                if (temp_files[running])
+                    DeleteFile(temp_files[running]);
+                failed = 1;
+                break;
+            }
+            processes[running++] = process;
+#else
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                failed = 1;
+                break;
+            }
+            if (pid == 0) {
+                execv(job[0], EXECVP_CAST job);
+                perror(job[0]);
+                _exit(127);
+            }
+            running++;
+#endif
+        }
+        if (!running)
+            break;
+#ifdef _WIN32
+        DWORD ret = WaitForMultipleObjects(running, processes, FALSE, INFINITE);
+        if (ret >= WAIT_OBJECT_0 + running) {
+            // Don't leave the remaining jobs running, or their temporary
+            // files behind.
+            for (int i = 0; i < running; i++) {
+                TerminateProcess(processes[i], 1);
+                WaitForSingleObject(processes[i], INFINITE);
+                CloseHandle(processes[i]);
+                if (temp_files[i])
+                    DeleteFile(temp_files[i]);
+            }
+            running = 0;
+            failed = 1;
+            break;
+        }
+        int i = ret - WAIT_OBJECT_0;
+        DWORD exit_code = 1;
+        GetExitCodeProcess(processes[i], &exit_code);
+        CloseHandle(processes[i]);
+        if (temp_files[i])
+            DeleteFile(temp_files[i]);
+        running--;
+        processes[i] = processes[running];
+        temp_files[i] = temp_files[running];
+        if (exit_code)
+            failed = 1;
+#else
+        int status;
+        if (wait(&status) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("wait");
+            failed = 1;
+            break;
+        }
+        running--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status))
+            failed = 1;
+#endif
+    }
+    jobserver_release();
+    return failed;
+}